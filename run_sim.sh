@@ -12,7 +12,7 @@ fi
 # Copy your simulation into ns-3 scratch/
 cp simulations/drone_wifi_simulation.cc "$NS3_PATH/scratch/"
 
-# Build and run the simulation
+# Build and run the simulation (extra arguments are passed through, e.g. --traceMode=record)
 cd "$NS3_PATH"
 ./ns3 build
-./ns3 run scratch/drone_wifi_simulation
+./ns3 run "scratch/drone_wifi_simulation $*"
@@ -2,28 +2,4335 @@
 #include "ns3/network-module.h"
 #include "ns3/internet-module.h"
 #include "ns3/yans-wifi-helper.h"
+#include "ns3/wifi-module.h"
+#include "ns3/mesh-module.h"
+#include "ns3/bridge-module.h"
+#include "ns3/olsr-module.h"
+#include "ns3/aodv-module.h"
+#include "ns3/dsdv-module.h"
+#include "ns3/traffic-control-module.h"
 #include "ns3/mobility-module.h"
 #include "ns3/applications-module.h"
+#include "ns3/propagation-module.h"
 #include "ns3/ssid.h"
 #include "ns3/config-store-module.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <tuple>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
 using namespace ns3;
 
-NS_LOG_COMPONENT_DEFINE("DroneWifiSimulation");
+NS_LOG_COMPONENT_DEFINE("DroneWifiSimulation");
+
+// Simulation parameters (settable from the command line)
+struct SimConfig
+{
+  std::string mode = "mobility";
+
+  // Trace-driven channel
+  std::string traceMode = "";
+  std::string traceFile = "link_trace.csv";
+  Time traceBin = MilliSeconds(500);
+  double replayRss = -50.0;
+
+  // Radios: defaults for every node, then per-role "standard,width,gi,streams" overrides
+  std::string standard = "80211n";
+  uint16_t channelWidth = 20;
+  uint16_t guardInterval = 800;
+  uint32_t spatialStreams = 1;
+  std::string userRadio = "";
+  std::string apRadio = "";
+  std::string relayRadio = "";
+
+  // Aggregation and Block Ack: defaults, then per-role "ampdu,amsdu" (bytes) overrides
+  uint32_t maxAmpduSize = 65535;
+  uint32_t maxAmsduSize = 0;
+  uint32_t blockAckThreshold = 0;
+  uint32_t blockAckTimeout = 0;
+  std::string userAggregation = "";
+  std::string apAggregation = "";
+  std::string relayAggregation = "";
+
+  // Rate adaptation
+  std::string rateManager = "Ideal";
+  uint32_t constantMcs = 7;
+  std::string mcsFile = "";
+
+  // Queue disc on the AP's and relays' interfaces: "default" (ns-3's), "pfifo", "codel", "fqcodel" or "pie"
+  std::string queueDisc = "default";
+  bool compareQueueDiscs = false;
+  Time queueSampleInterval = MilliSeconds(10);
+
+  // Two-way relay network coding
+  Time codingHold = MilliSeconds(2);
+
+  // Multipath duplication
+  std::string duplicationRate = "4Mbps";
+  uint32_t duplicationWindow = 1024; // sequence numbers remembered by the receiver
+
+  // Opportunistic forwarding along relay chains
+  std::string exorRate = "8Mbps";
+  Time exorSlot = MilliSeconds(2); // hold per higher-priority relay
+
+  // Link-budget TX power control and multi-cell scenarios
+  bool powerControl = false;
+  uint32_t powerTargetMcs = 7;
+  double powerMargin = 3.0; // dB above the target MCS's sensitivity
+  uint32_t cells = 3;
+  double cellSpacing = 200.0;
+
+  // Block FEC on the echo requests
+  bool fec = false;
+  uint32_t fecBlock = 4;      // requests per block
+  uint32_t fecMinRepair = 1;  // repairs per block on a loss-free link
+  uint32_t fecMaxRepair = 8;
+  bool compareFec = false;
+
+  // Relay radios: 1 (access and backhaul share a channel) or 2 (separate channels)
+  uint32_t relayRadios = 1;
+  std::string forwarding = "routed"; // "routed" (IP host routes), "mesh" (802.11s) or "bridged" (repeater APs)
+  bool compareForwarding = false;
+  std::string routing = "static"; // routed relays: "static" (controller routes), "olsr", "aodv" or "dsdv"
+  bool compareRouting = false;
+  bool prepopulateArp = false; // static routing: the controller also fills the hops' ARP caches
+
+  // Handover of the user STA between the AP and drone APs
+  Time beaconInterval = MicroSeconds(102400);
+  bool activeProbing = false;
+  uint32_t maxMissedBeacons = 10;
+  std::string handover = "roam"; // "roam" (on beacon loss) or "directed" (by the controller)
+  uint32_t handoverRuns = 0;
+  std::string channelAssignment = "alternate";
+  uint32_t channelCount = 0; // backhaul channels available, 0 for all of the relay width
+
+  // Propagation
+  std::string propagation = "logdistance";
+  std::string a2gEnvironment = "suburban";
+
+  // Static snapshot probes
+  uint32_t relays = 1;
+  Time probeTime = Seconds(2.0);
+  Time probeWarmup = Seconds(1.0);
+  std::string probeRate = "100Mbps";
+  uint32_t jobs = std::max(1u, std::thread::hardware_concurrency());
+
+  // Crossover search
+  double crossoverMin = 10.0;
+  double crossoverMax = 300.0;
+  double crossoverTolerance = 1.0;
+
+  // Coverage heatmap
+  double gridRadius = 300.0;
+  double gridStep = 25.0;
+  uint32_t placementSteps = 5;
+  uint32_t heatmapRelays = 2;
+  std::string heatmapFile = "heatmap";
+
+  // Relay placement search
+  std::string placementAltitudes = "";
+  double userDistance = 150.0;
+
+  // Drone deployment in the mobility run
+  std::string trigger = "";
+  uint32_t drones = 1;
+  double lossThreshold = 0.5;
+  bool fixableLossOnly = false; // loss trigger ignores intervals dominated by congestion
+  double droneSpeed = 10.0;
+  double droneAccel = 3.0;
+  double climbRate = 3.0;
+  double droneAltitude = 10.0;
+  Time flightStep = MilliSeconds(100);
+
+  // Predictive deployment
+  double degradeRss = -85.0;
+  Time predictStep = MilliSeconds(100);
+  Time predictHorizon = Seconds(60.0);
+  Time predictMargin = Seconds(1.0);
+  bool compareTriggers = false;
+  bool adhocBaseline = false; // run without drones on the ad-hoc network too
+  Time recallTime = Seconds(0); // drones leave at this time, 0 never
+  bool quiet = false;
+};
+
+SimConfig g_config;
+
+// Globals for tracking
+uint64_t g_txPackets = 0;
+uint64_t g_rxPackets = 0;
+Ptr<Node> g_user;
+Ptr<Node> g_ap;
+
+// Send time of every echo request and, for those that reached the AP, the
+// arrival time, by packet uid
+std::map<uint64_t, Time> g_sentAt;
+std::map<uint64_t, Time> g_delivered;
+
+// Progress of the drone deployment in the mobility run
+struct DeploymentState
+{
+  bool triggered = false;
+  bool usable = false;    // every drone has reached its relay point
+  bool recovered = false; // a packet was delivered once the relay became usable
+  bool recalled = false;  // the drones have left
+  Time triggerTime;
+  Time usableTime;
+  Time recoveredTime;
+  uint64_t txAtTrigger = 0;
+  uint64_t rxAtTrigger = 0;
+  uint64_t txAtRecovery = 0;
+  uint64_t rxAtRecovery = 0;
+};
+
+DeploymentState g_deployment;
+
+// Maps every Wi-Fi MAC address in the simulation to the id of its node
+std::map<Mac48Address, uint32_t> g_macToNode;
+
+// Role names ("user", "ap", "relay0", ...) of the nodes, by node id
+std::map<uint32_t, std::string> g_nodeNames;
+
+std::string NodeName(uint32_t id)
+{
+  auto it = g_nodeNames.find(id);
+  return it != g_nodeNames.end() ? it->second : "node" + std::to_string(id);
+}
+
+// Parse a comma-separated list of numbers
+std::vector<double> ParseList(const std::string &list)
+{
+  std::vector<double> values;
+  std::istringstream in(list);
+  std::string item;
+  while (std::getline(in, item, ','))
+    {
+      if (!item.empty())
+        values.push_back(std::stod(item));
+    }
+  return values;
+}
+
+// Collect packet Tx/Rx stats
+void TxTrace(Ptr<const Packet> p)
+{
+  g_txPackets++;
+  g_sentAt[p->GetUid()] = Simulator::Now();
+}
+
+void RxTrace(Ptr<const Packet> p, const Address &)
+{
+  g_rxPackets++;
+  g_delivered[p->GetUid()] = Simulator::Now();
+  if (g_deployment.usable && !g_deployment.recovered)
+    {
+      g_deployment.recovered = true;
+      g_deployment.recoveredTime = Simulator::Now();
+      // Both counts include this request but none sent after it
+      g_deployment.txAtRecovery = g_txPackets - std::distance(g_sentAt.upper_bound(p->GetUid()), g_sentAt.end());
+      g_deployment.rxAtRecovery = g_rxPackets;
+    }
+}
+
+// Rebuild g_macToNode from the devices installed so far
+void BuildMacTable()
+{
+  g_macToNode.clear();
+  for (NodeList::Iterator it = NodeList::Begin(); it != NodeList::End(); ++it)
+    {
+      for (uint32_t i = 0; i < (*it)->GetNDevices(); i++)
+        {
+          Ptr<WifiNetDevice> dev = DynamicCast<WifiNetDevice>((*it)->GetDevice(i));
+          if (dev)
+            g_macToNode[Mac48Address::ConvertFrom(dev->GetAddress())] = (*it)->GetId();
+        }
+    }
+}
+
+// Read the MAC header of an MPDU (or of the first MPDU of an A-MPDU).
+// Returns false for frames that are not data frames.
+bool PeekDataHeader(Ptr<const Packet> p, WifiMacHeader &hdr)
+{
+  Ptr<Packet> copy = p->Copy();
+  AmpduSubframeHeader subframe;
+  copy->PeekHeader(subframe);
+  if (subframe.IsSignatureValid())
+    copy->RemoveHeader(subframe);
+
+  copy->PeekHeader(hdr);
+  return hdr.IsData();
+}
+
+// Find the transmitter of a data frame. Returns false for other frames and
+// for transmitters that are not known nodes.
+bool GetDataTransmitter(Ptr<const Packet> p, uint32_t &txNode)
+{
+  WifiMacHeader hdr;
+  if (!PeekDataHeader(p, hdr))
+    return false;
+
+  auto it = g_macToNode.find(hdr.GetAddr2());
+  if (it == g_macToNode.end())
+    return false;
+  txNode = it->second;
+  return true;
+}
+
+// Find both ends of a unicast data frame between known nodes
+bool GetDataLink(Ptr<const Packet> p, uint32_t &txNode, uint32_t &rxNode)
+{
+  WifiMacHeader hdr;
+  if (!PeekDataHeader(p, hdr))
+    return false;
+
+  auto tx = g_macToNode.find(hdr.GetAddr2());
+  auto rx = g_macToNode.find(hdr.GetAddr1());
+  if (tx == g_macToNode.end() || rx == g_macToNode.end())
+    return false;
+  txNode = tx->second;
+  rxNode = rx->second;
+  return true;
+}
+
+// ---------------------------------------------------------------------------
+// Trace-driven channel
+//
+// A reference run ("record") counts, for every (transmitter, receiver) pair,
+// how many data frames were decoded and how many were lost in each time bin.
+// Unicast frames are counted as sent at the transmitter, so a frame the
+// addressee never decodes (payload error, below sensitivity, collision) is
+// lost; frames a node overhears or receives by broadcast count as lost when
+// its PHY drops them or fails to decode the payload.
+// A later run over the same mobility trace ("replay") swaps the propagation
+// model for a fixed, always-decodable RSS and drops frames through
+// TraceReplayErrorModel with the recorded per-bin error rate instead.
+// ---------------------------------------------------------------------------
+
+// (bin, tx node, rx node) -> {decoded, lost}
+typedef std::tuple<uint32_t, uint32_t, uint32_t> LinkBin;
+std::map<LinkBin, std::pair<uint64_t, uint64_t>> g_linkCounts;
+
+// (packet uid, addressee) -> bin of the latest transmission still counted lost
+std::map<std::pair<uint64_t, uint32_t>, uint32_t> g_pendingTx;
+
+uint32_t CurrentBin() { return Simulator::Now().GetInteger() / g_config.traceBin.GetInteger(); }
+
+// True if `p` is a data frame addressed to `rxNode`, which its transmitter
+// already counted
+bool IsAddressedTo(Ptr<const Packet> p, uint32_t rxNode)
+{
+  uint32_t txNode;
+  uint32_t addressee;
+  return GetDataLink(p, txNode, addressee) && addressee == rxNode;
+}
+
+// Every unicast data frame starts out lost until its addressee decodes it
+void RecordTx(uint32_t txNode, Ptr<const Packet> p, uint16_t channelFreqMhz, WifiTxVector txVector, MpduInfo aMpdu,
+              uint16_t staId)
+{
+  uint32_t tx;
+  uint32_t rx;
+  if (!GetDataLink(p, tx, rx))
+    return;
+  g_linkCounts[LinkBin(CurrentBin(), tx, rx)].second++;
+  g_pendingTx[std::make_pair(p->GetUid(), rx)] = CurrentBin();
+}
+
+void RecordRxOk(uint32_t rxNode, Ptr<const Packet> p, uint16_t channelFreqMhz,
+                WifiTxVector txVector, MpduInfo aMpdu, SignalNoiseDbm signalNoise, uint16_t staId)
+{
+  uint32_t txNode;
+  if (!GetDataTransmitter(p, txNode))
+    return;
+  g_linkCounts[LinkBin(CurrentBin(), txNode, rxNode)].first++;
+  if (!IsAddressedTo(p, rxNode))
+    return;
+  // Take back the loss counted at transmission, in the bin it was sent in.
+  // Retries share the uid; the decoded one is the latest.
+  auto pending = g_pendingTx.find(std::make_pair(p->GetUid(), rxNode));
+  if (pending == g_pendingTx.end())
+    return;
+  g_linkCounts[LinkBin(pending->second, txNode, rxNode)].second--;
+  g_pendingTx.erase(pending);
+}
+
+// Payload decode failures (the preamble and header were received)
+void RecordRxError(uint32_t rxNode, Ptr<const Packet> p, double snr)
+{
+  uint32_t txNode;
+  if (!IsAddressedTo(p, rxNode) && GetDataTransmitter(p, txNode))
+    g_linkCounts[LinkBin(CurrentBin(), txNode, rxNode)].second++;
+}
+
+void RecordRxDrop(uint32_t rxNode, Ptr<const Packet> p, WifiPhyRxfailureReason reason)
+{
+  // Drops caused by the receiver's own state say nothing about the channel
+  switch (reason)
+    {
+    case TXING:
+    case SLEEPING:
+    case POWERED_OFF:
+    case CHANNEL_SWITCHING:
+      return;
+    default:
+      break;
+    }
+
+  uint32_t txNode;
+  if (!IsAddressedTo(p, rxNode) && GetDataTransmitter(p, txNode))
+    g_linkCounts[LinkBin(CurrentBin(), txNode, rxNode)].second++;
+}
+
+void EnableLinkRecording()
+{
+  for (NodeList::Iterator it = NodeList::Begin(); it != NodeList::End(); ++it)
+    {
+      for (uint32_t i = 0; i < (*it)->GetNDevices(); i++)
+        {
+          Ptr<WifiNetDevice> dev = DynamicCast<WifiNetDevice>((*it)->GetDevice(i));
+          if (!dev)
+            continue;
+          uint32_t id = (*it)->GetId();
+          dev->GetPhy()->TraceConnectWithoutContext("MonitorSnifferTx", MakeBoundCallback(&RecordTx, id));
+          dev->GetPhy()->TraceConnectWithoutContext("MonitorSnifferRx", MakeBoundCallback(&RecordRxOk, id));
+          dev->GetPhy()->TraceConnectWithoutContext("PhyRxDrop", MakeBoundCallback(&RecordRxDrop, id));
+          dev->GetPhy()->GetState()->TraceConnectWithoutContext("RxError", MakeBoundCallback(&RecordRxError, id));
+        }
+    }
+}
+
+void WriteLinkTrace(const std::string &fileName)
+{
+  std::ofstream out(fileName);
+  out << "# bin_ns=" << g_config.traceBin.GetInteger() << "\n";
+  out << "bin,tx,rx,ok,lost\n";
+  for (const auto &entry : g_linkCounts)
+    {
+      out << std::get<0>(entry.first) << "," << std::get<1>(entry.first) << ","
+          << std::get<2>(entry.first) << "," << entry.second.first << ","
+          << entry.second.second << "\n";
+    }
+  std::cout << "Recorded " << g_linkCounts.size() << " link bins to " << fileName << std::endl;
+}
+
+// (tx node, rx node) -> bin -> packet error rate
+typedef std::map<std::pair<uint32_t, uint32_t>, std::map<uint32_t, double>> PerTable;
+
+bool ReadLinkTrace(const std::string &fileName, PerTable &table)
+{
+  std::ifstream in(fileName);
+  if (!in)
+    return false;
+
+  std::string line;
+  while (std::getline(in, line))
+    {
+      if (line.empty())
+        continue;
+      if (line.rfind("# bin_ns=", 0) == 0)
+        {
+          g_config.traceBin = NanoSeconds(std::stoll(line.substr(9)));
+          continue;
+        }
+      if (line[0] == '#' || line.rfind("bin", 0) == 0)
+        continue;
+
+      std::istringstream fields(line);
+      uint32_t bin, tx, rx;
+      uint64_t ok, lost;
+      char sep;
+      fields >> bin >> sep >> tx >> sep >> rx >> sep >> ok >> sep >> lost;
+      if (ok + lost > 0)
+        table[std::make_pair(tx, rx)][bin] = (double)lost / (ok + lost);
+    }
+  return true;
+}
+
+class TraceReplayErrorModel : public ErrorModel
+{
+public:
+  static TypeId GetTypeId()
+  {
+    static TypeId tid = TypeId("ns3::TraceReplayErrorModel")
+                            .SetParent<ErrorModel>()
+                            .AddConstructor<TraceReplayErrorModel>();
+    return tid;
+  }
+
+  TraceReplayErrorModel() : m_rxNode(0), m_table(nullptr)
+  {
+    m_rng = CreateObject<UniformRandomVariable>();
+  }
+
+  void Setup(uint32_t rxNode, const PerTable *table)
+  {
+    m_rxNode = rxNode;
+    m_table = table;
+  }
+
+  int64_t AssignStreams(int64_t stream)
+  {
+    m_rng->SetStream(stream);
+    return 1;
+  }
+
+private:
+  bool DoCorrupt(Ptr<Packet> p) override
+  {
+    uint32_t txNode;
+    if (!GetDataTransmitter(p, txNode))
+      return false;
+    return m_rng->GetValue() < GetPer(txNode);
+  }
+
+  void DoReset() override {}
+
+  double GetPer(uint32_t txNode) const
+  {
+    auto link = m_table->find(std::make_pair(txNode, m_rxNode));
+    // A link that never delivered anything in the reference run is out of range
+    if (link == m_table->end())
+      return 1.0;
+
+    // Bins without traffic keep the rate of the last bin that had some
+    auto bin = link->second.upper_bound(CurrentBin());
+    if (bin == link->second.begin())
+      return bin->second;
+    return std::prev(bin)->second;
+  }
+
+  uint32_t m_rxNode;
+  const PerTable *m_table;
+  Ptr<UniformRandomVariable> m_rng;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(TraceReplayErrorModel);
+
+PerTable g_perTable;
+
+void EnableLinkReplay()
+{
+  int64_t stream = 1000;
+  for (NodeList::Iterator it = NodeList::Begin(); it != NodeList::End(); ++it)
+    {
+      for (uint32_t i = 0; i < (*it)->GetNDevices(); i++)
+        {
+          Ptr<WifiNetDevice> dev = DynamicCast<WifiNetDevice>((*it)->GetDevice(i));
+          if (!dev)
+            continue;
+          Ptr<TraceReplayErrorModel> em = CreateObject<TraceReplayErrorModel>();
+          em->Setup((*it)->GetId(), &g_perTable);
+          stream += em->AssignStreams(stream);
+          dev->GetPhy()->SetPostReceptionErrorModel(em);
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Per-link rate tracing
+//
+// Every data MPDU a PHY sends is attributed to its (transmitter, receiver)
+// link together with the MCS and PHY rate the rate manager picked, so the
+// monitor can show whether a relayed hop gains through a higher MCS, and
+// with its place in an A-MPDU, to show the aggregate sizes each hop reaches.
+// ---------------------------------------------------------------------------
+
+struct LinkRateStats
+{
+  uint64_t frames = 0;
+  double mcsSum = 0;
+  double rateSum = 0; // bit/s
+  uint64_t bytes = 0;
+  uint64_t ampdus = 0;
+  uint64_t aggregatedMpdus = 0;
+  uint64_t aggregatedBytes = 0;
+};
+
+// (tx node, rx node) -> rate statistics of the current monitor interval
+std::map<std::pair<uint32_t, uint32_t>, LinkRateStats> g_linkRates;
+std::ofstream g_mcsLog;
+
+void RateTxTrace(Ptr<const Packet> p, uint16_t channelFreqMhz, WifiTxVector txVector, MpduInfo aMpdu, uint16_t staId)
+{
+  uint32_t txNode;
+  uint32_t rxNode;
+  if (!GetDataLink(p, txNode, rxNode))
+    return;
+
+  WifiMode mode = txVector.GetMode();
+  WifiModulationClass modClass = mode.GetModulationClass();
+  bool hasMcs = modClass == WIFI_MOD_CLASS_HT || modClass == WIFI_MOD_CLASS_VHT || modClass == WIFI_MOD_CLASS_HE;
+
+  LinkRateStats &stats = g_linkRates[std::make_pair(txNode, rxNode)];
+  stats.frames++;
+  stats.mcsSum += hasMcs ? mode.GetMcsValue() : 0;
+  stats.rateSum += mode.GetDataRate(txVector);
+  stats.bytes += p->GetSize();
+  if (aMpdu.type == FIRST_MPDU_IN_AGGREGATE)
+    stats.ampdus++;
+  if (aMpdu.type == FIRST_MPDU_IN_AGGREGATE || aMpdu.type == MIDDLE_MPDU_IN_AGGREGATE ||
+      aMpdu.type == LAST_MPDU_IN_AGGREGATE)
+    {
+      stats.aggregatedMpdus++;
+      stats.aggregatedBytes += p->GetSize();
+    }
+}
+
+void EnableRateTracing()
+{
+  for (NodeList::Iterator it = NodeList::Begin(); it != NodeList::End(); ++it)
+    {
+      for (uint32_t i = 0; i < (*it)->GetNDevices(); i++)
+        {
+          Ptr<WifiNetDevice> dev = DynamicCast<WifiNetDevice>((*it)->GetDevice(i));
+          if (dev)
+            dev->GetPhy()->TraceConnectWithoutContext("MonitorSnifferTx", MakeCallback(&RateTxTrace));
+        }
+    }
+  if (!g_config.mcsFile.empty())
+    {
+      g_mcsLog.open(g_config.mcsFile);
+      g_mcsLog << "time_s,tx,rx,frames,mean_mcs,mean_rate_mbps,mean_mpdu_bytes,ampdus,mean_ampdu_mpdus,mean_ampdu_bytes\n";
+    }
+}
+
+// Print (and log) the mean MCS and aggregate sizes of every link over the
+// last interval, then reset
+void ReportLinkRates()
+{
+  for (const auto &entry : g_linkRates)
+    {
+      const LinkRateStats &stats = entry.second;
+      std::string tx = NodeName(entry.first.first);
+      std::string rx = NodeName(entry.first.second);
+      double meanMcs = stats.mcsSum / stats.frames;
+      double meanRate = stats.rateSum / stats.frames / 1e6;
+      double meanMpdu = (double)stats.bytes / stats.frames;
+      double ampduMpdus = stats.ampdus ? (double)stats.aggregatedMpdus / stats.ampdus : 0.0;
+      double ampduBytes = stats.ampdus ? (double)stats.aggregatedBytes / stats.ampdus : 0.0;
+      if (!g_config.quiet)
+        std::cout << "  " << tx << "->" << rx << ": MCS " << meanMcs << ", " << meanRate << " Mbps ("
+                  << stats.frames << " frames of " << meanMpdu << " B, " << stats.ampdus << " A-MPDUs of "
+                  << ampduMpdus << " MPDUs / " << ampduBytes << " B)" << std::endl;
+      if (g_mcsLog.is_open())
+        g_mcsLog << Simulator::Now().GetSeconds() << "," << tx << "," << rx << "," << stats.frames << ","
+                 << meanMcs << "," << meanRate << "," << meanMpdu << "," << stats.ampdus << ","
+                 << ampduMpdus << "," << ampduBytes << "\n";
+    }
+  g_linkRates.clear();
+}
+
+// ---------------------------------------------------------------------------
+// Air-to-ground propagation
+//
+// Mean path loss of the air-to-ground model of Al-Hourani et al. ("Optimal
+// LAP altitude for maximum coverage", 2014): free-space loss plus an excess
+// loss weighted by the probability of line of sight, which grows with the
+// elevation angle between the ground node and the drone. Links between two
+// nodes on the ground keep the log-distance model.
+// ---------------------------------------------------------------------------
+
+class AirToGroundPropagationLossModel : public PropagationLossModel
+{
+public:
+  static TypeId GetTypeId()
+  {
+    static TypeId tid =
+        TypeId("ns3::AirToGroundPropagationLossModel")
+            .SetParent<PropagationLossModel>()
+            .AddConstructor<AirToGroundPropagationLossModel>()
+            .AddAttribute("Frequency", "Carrier frequency (Hz)", DoubleValue(5.18e9),
+                          MakeDoubleAccessor(&AirToGroundPropagationLossModel::m_frequency),
+                          MakeDoubleChecker<double>())
+            .AddAttribute("A", "Environment parameter a of the LoS probability", DoubleValue(4.88),
+                          MakeDoubleAccessor(&AirToGroundPropagationLossModel::m_a),
+                          MakeDoubleChecker<double>())
+            .AddAttribute("B", "Environment parameter b of the LoS probability", DoubleValue(0.43),
+                          MakeDoubleAccessor(&AirToGroundPropagationLossModel::m_b),
+                          MakeDoubleChecker<double>())
+            .AddAttribute("EtaLos", "Excess loss (dB) over free space with line of sight", DoubleValue(0.1),
+                          MakeDoubleAccessor(&AirToGroundPropagationLossModel::m_etaLos),
+                          MakeDoubleChecker<double>())
+            .AddAttribute("EtaNlos", "Excess loss (dB) over free space without line of sight", DoubleValue(21.0),
+                          MakeDoubleAccessor(&AirToGroundPropagationLossModel::m_etaNlos),
+                          MakeDoubleChecker<double>())
+            .AddAttribute("GroundHeight", "Height (m) below which both ends of a link count as on the ground",
+                          DoubleValue(1.0),
+                          MakeDoubleAccessor(&AirToGroundPropagationLossModel::m_groundHeight),
+                          MakeDoubleChecker<double>());
+    return tid;
+  }
+
+  AirToGroundPropagationLossModel()
+  {
+    m_ground = CreateObject<LogDistancePropagationLossModel>();
+  }
+
+  // Use the parameters Al-Hourani et al. fit for a named environment
+  void SetEnvironment(const std::string &environment)
+  {
+    if (environment == "suburban")
+      SetParameters(4.88, 0.43, 0.1, 21.0);
+    else if (environment == "urban")
+      SetParameters(9.61, 0.16, 1.0, 20.0);
+    else if (environment == "denseurban")
+      SetParameters(12.08, 0.11, 1.6, 23.0);
+    else if (environment == "highrise")
+      SetParameters(27.23, 0.08, 2.3, 34.0);
+    else
+      NS_FATAL_ERROR("Unknown air-to-ground environment \"" << environment << "\"");
+  }
+
+  // Probability of line of sight at an elevation angle in degrees
+  double GetLosProbability(double elevation) const
+  {
+    return 1.0 / (1.0 + m_a * std::exp(-m_b * (elevation - m_a)));
+  }
+
+private:
+  void SetParameters(double a, double b, double etaLos, double etaNlos)
+  {
+    m_a = a;
+    m_b = b;
+    m_etaLos = etaLos;
+    m_etaNlos = etaNlos;
+  }
+
+  double DoCalcRxPower(double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const override
+  {
+    Vector pa = a->GetPosition();
+    Vector pb = b->GetPosition();
+    if (pa.z < m_groundHeight && pb.z < m_groundHeight)
+      return m_ground->CalcRxPower(txPowerDbm, a, b);
+
+    double horizontal = std::hypot(pa.x - pb.x, pa.y - pb.y);
+    double distance = std::max(1.0, a->GetDistanceFrom(b));
+    double elevation = std::atan2(std::abs(pa.z - pb.z), horizontal) * 180.0 / M_PI;
+    double pLos = GetLosProbability(elevation);
+
+    double freeSpace = 20.0 * std::log10(distance) + 20.0 * std::log10(m_frequency) - 147.55;
+    return txPowerDbm - (freeSpace + pLos * m_etaLos + (1.0 - pLos) * m_etaNlos);
+  }
+
+  int64_t DoAssignStreams(int64_t stream) override { return 0; }
+
+  double m_frequency;
+  double m_a;
+  double m_b;
+  double m_etaLos;
+  double m_etaNlos;
+  double m_groundHeight;
+  Ptr<LogDistancePropagationLossModel> m_ground;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(AirToGroundPropagationLossModel);
+
+// ---------------------------------------------------------------------------
+// Scenario construction
+// ---------------------------------------------------------------------------
+
+// One link of the relay chain, between the devices of two neighbouring
+// nodes; `near` is the end closer to the user
+struct Hop
+{
+  Ptr<NetDevice> near;
+  Ptr<NetDevice> far;
+  uint16_t channel; // 0 for the primary channel
+};
+
+// Nodes and devices of one scenario
+struct Topology
+{
+  NodeContainer user;
+  NodeContainer ap;
+  NodeContainer relays; // ordered from the user towards the AP
+  NetDeviceContainer devices; // primary network: user, AP, then the relays on it
+  Ipv4InterfaceContainer interfaces;
+  std::vector<Hop> hops; // user -> relays -> AP, empty without relays
+  YansWifiPhyHelper phy;
+  std::string relayMobility = "ns3::ConstantPositionMobilityModel";
+  Ptr<YansWifiChannel> channel; // shared with other cells; null creates one
+  uint32_t subnet = 1;          // addresses in 10.<subnet>.0.0/16
+
+  Ipv4Address UserAddress() const { return interfaces.GetAddress(0); }
+  Ipv4Address ApAddress() const { return interfaces.GetAddress(1); }
+};
+
+// Address and interface index of an installed device
+std::pair<Ipv4Address, uint32_t> GetDeviceAddress(Ptr<NetDevice> dev)
+{
+  Ptr<Ipv4> ipv4 = dev->GetNode()->GetObject<Ipv4>();
+  int32_t ifIndex = ipv4->GetInterfaceForDevice(dev);
+  NS_ABORT_MSG_IF(ifIndex < 0, "Device has no IPv4 interface");
+  return std::make_pair(ipv4->GetAddress(ifIndex, 0).GetLocal(), (uint32_t)ifIndex);
+}
+
+// PHY of the first Wi-Fi interface of a node (mesh points put theirs behind
+// the MeshPointDevice)
+Ptr<WifiPhy> FirstWifiPhy(Ptr<Node> node)
+{
+  for (uint32_t i = 0; i < node->GetNDevices(); i++)
+    {
+      Ptr<WifiNetDevice> dev = DynamicCast<WifiNetDevice>(node->GetDevice(i));
+      if (dev)
+        return dev->GetPhy();
+    }
+  NS_FATAL_ERROR("Node " << node->GetId() << " has no Wi-Fi device");
+  return nullptr;
+}
+
+// Non-overlapping 5 GHz channels of a given width
+std::vector<uint16_t> ChannelsForWidth(uint16_t width)
+{
+  switch (width)
+    {
+    case 20:
+      return {36, 40, 44, 48, 52, 56, 60, 64};
+    case 40:
+      return {38, 46, 54, 62};
+    case 80:
+      return {42, 58, 106, 122};
+    default:
+      return {50, 114};
+    }
+}
+
+// Propagation model of the scenario, also used for link budget predictions
+Ptr<PropagationLossModel> g_lossModel;
+
+Ptr<PropagationLossModel> CreateLossModel()
+{
+  if (g_config.propagation == "logdistance")
+    return CreateObject<LogDistancePropagationLossModel>();
+  if (g_config.propagation == "a2g")
+    {
+      Ptr<AirToGroundPropagationLossModel> a2g = CreateObject<AirToGroundPropagationLossModel>();
+      a2g->SetEnvironment(g_config.a2gEnvironment);
+      return a2g;
+    }
+  NS_FATAL_ERROR("Unknown propagation model \"" << g_config.propagation << "\"");
+  return nullptr;
+}
+
+Ptr<YansWifiChannel> CreateChannel()
+{
+  g_lossModel = CreateLossModel();
+
+  Ptr<YansWifiChannel> channel = CreateObject<YansWifiChannel>();
+  channel->SetPropagationDelayModel(CreateObject<ConstantSpeedPropagationDelayModel>());
+  if (g_config.traceMode == "replay")
+    {
+      // Every frame arrives strong enough to decode; losses come from the trace
+      Ptr<FixedRssLossModel> fixed = CreateObject<FixedRssLossModel>();
+      fixed->SetRss(g_config.replayRss);
+      channel->SetPropagationLossModel(fixed);
+    }
+  else
+    channel->SetPropagationLossModel(g_lossModel);
+  return channel;
+}
+
+// Wi-Fi settings of one node role (user, AP or relay)
+struct RadioProfile
+{
+  std::string standard;
+  uint16_t channelWidth;  // MHz
+  uint16_t guardInterval; // ns
+  uint32_t spatialStreams;
+};
+
+WifiStandard ParseStandard(const std::string &standard)
+{
+  if (standard == "80211n")
+    return WIFI_STANDARD_80211n;
+  if (standard == "80211ac")
+    return WIFI_STANDARD_80211ac;
+  if (standard == "80211ax")
+    return WIFI_STANDARD_80211ax;
+  NS_FATAL_ERROR("Unknown Wi-Fi standard \"" << standard << "\"");
+  return WIFI_STANDARD_UNSPECIFIED;
+}
+
+// The global radio settings, overridden field by field by a role's
+// "standard,width,gi,streams" string (trailing fields may be left out)
+RadioProfile GetRadioProfile(const std::string &roleSpec)
+{
+  RadioProfile profile = {g_config.standard, g_config.channelWidth, g_config.guardInterval, g_config.spatialStreams};
+  std::vector<std::string> fields;
+  std::istringstream in(roleSpec);
+  std::string field;
+  while (std::getline(in, field, ','))
+    fields.push_back(field);
+  if (fields.size() > 0 && !fields[0].empty())
+    profile.standard = fields[0];
+  if (fields.size() > 1 && !fields[1].empty())
+    profile.channelWidth = std::stoi(fields[1]);
+  if (fields.size() > 2 && !fields[2].empty())
+    profile.guardInterval = std::stoi(fields[2]);
+  if (fields.size() > 3 && !fields[3].empty())
+    profile.spatialStreams = std::stoi(fields[3]);
+
+  ParseStandard(profile.standard);
+  uint16_t maxWidth = profile.standard == "80211n" ? 40 : 160;
+  NS_ABORT_MSG_IF(profile.channelWidth != 20 && profile.channelWidth != 40 && profile.channelWidth != 80 &&
+                      profile.channelWidth != 160,
+                  "Channel width must be 20, 40, 80 or 160 MHz");
+  NS_ABORT_MSG_IF(profile.channelWidth > maxWidth, profile.standard << " supports at most " << maxWidth << " MHz");
+  if (profile.standard == "80211ax")
+    NS_ABORT_MSG_IF(profile.guardInterval != 800 && profile.guardInterval != 1600 && profile.guardInterval != 3200,
+                    "802.11ax guard interval must be 800, 1600 or 3200 ns");
+  else
+    NS_ABORT_MSG_IF(profile.guardInterval != 400 && profile.guardInterval != 800,
+                    profile.standard << " guard interval must be 400 or 800 ns");
+  NS_ABORT_MSG_IF(profile.spatialStreams < 1 || profile.spatialStreams > 4, "Spatial streams must be 1 to 4");
+  return profile;
+}
+
+// Select the remote station manager; the constant rate uses constantMcs in
+// the MCS family of the role's standard
+void SetRateManager(WifiHelper &wifi, const RadioProfile &profile)
+{
+  const std::string &manager = g_config.rateManager;
+  if (manager == "Constant")
+    {
+      std::string family = profile.standard == "80211n" ? "HtMcs" : profile.standard == "80211ac" ? "VhtMcs" : "HeMcs";
+      wifi.SetRemoteStationManager("ns3::ConstantRateWifiManager",
+                                   "DataMode", StringValue(family + std::to_string(g_config.constantMcs)),
+                                   "ControlMode", StringValue("OfdmRate6Mbps"));
+    }
+  else if (manager == "Ideal")
+    wifi.SetRemoteStationManager("ns3::IdealWifiManager");
+  else if (manager == "MinstrelHt")
+    wifi.SetRemoteStationManager("ns3::MinstrelHtWifiManager");
+  else if (manager == "ThompsonSampling")
+    wifi.SetRemoteStationManager("ns3::ThompsonSamplingWifiManager");
+  else
+    NS_FATAL_ERROR("Unknown rate manager \"" << manager << "\"");
+}
+
+// Aggregation and Block Ack settings of one node role
+struct AggregationProfile
+{
+  uint32_t maxAmpduSize; // bytes, 0 disables A-MPDU
+  uint32_t maxAmsduSize; // bytes, 0 disables A-MSDU
+};
+
+// The global aggregation settings, overridden by a role's "ampdu,amsdu" string
+AggregationProfile GetAggregationProfile(const std::string &roleSpec)
+{
+  AggregationProfile profile = {g_config.maxAmpduSize, g_config.maxAmsduSize};
+  std::vector<double> fields = ParseList(roleSpec);
+  if (fields.size() > 0)
+    profile.maxAmpduSize = fields[0];
+  if (fields.size() > 1)
+    profile.maxAmsduSize = fields[1];
+  return profile;
+}
+
+// Apply a role's aggregation sizes to every access category, and the Block
+// Ack settings to best effort (the class all simulated traffic uses)
+void ConfigureAggregation(Ptr<WifiNetDevice> dev, const AggregationProfile &profile)
+{
+  Ptr<WifiMac> mac = dev->GetMac();
+  for (const std::string ac : {"VO", "VI", "BE", "BK"})
+    {
+      mac->SetAttribute(ac + "_MaxAmpduSize", UintegerValue(profile.maxAmpduSize));
+      mac->SetAttribute(ac + "_MaxAmsduSize", UintegerValue(profile.maxAmsduSize));
+    }
+
+  // 0 leaves the ns-3 defaults; a setting this ns-3 version cannot apply is an error
+  Ptr<QosTxop> be = mac->GetQosTxop(AC_BE);
+  NS_ABORT_MSG_IF(g_config.blockAckThreshold > 0 &&
+                      !be->SetAttributeFailSafe("BlockAckThreshold", UintegerValue(g_config.blockAckThreshold)),
+                  "--blockAckThreshold is not supported by this ns-3 version");
+  NS_ABORT_MSG_IF(g_config.blockAckTimeout > 0 &&
+                      !be->SetAttributeFailSafe("BlockAckInactivityTimeout", UintegerValue(g_config.blockAckTimeout)),
+                  "--blockAckTimeout is not supported by this ns-3 version");
+}
+
+// Radio and aggregation overrides of a role ("user", "ap" or "relay")
+const std::string &RoleRadio(const std::string &role)
+{
+  return role == "user" ? g_config.userRadio : role == "ap" ? g_config.apRadio : g_config.relayRadio;
+}
+
+const std::string &RoleAggregation(const std::string &role)
+{
+  return role == "user" ? g_config.userAggregation : role == "ap" ? g_config.apAggregation : g_config.relayAggregation;
+}
+
+// Install Wi-Fi devices with a role's radio settings on `nodes`, tuned to
+// `channel` (0 selects the default channel for the role's width)
+NetDeviceContainer InstallRadio(const Topology &topo, const std::string &role, const WifiMacHelper &mac,
+                                NodeContainer nodes, uint16_t channel = 0)
+{
+  RadioProfile profile = GetRadioProfile(RoleRadio(role));
+  AggregationProfile aggregation = GetAggregationProfile(RoleAggregation(role));
+
+  WifiHelper wifi;
+  wifi.SetStandard(ParseStandard(profile.standard));
+  SetRateManager(wifi, profile);
+
+  YansWifiPhyHelper phy = topo.phy;
+  std::ostringstream channelSettings;
+  channelSettings << "{" << channel << ", " << profile.channelWidth << ", BAND_5GHZ, 0}";
+  phy.Set("ChannelSettings", StringValue(channelSettings.str()));
+  phy.Set("Antennas", UintegerValue(profile.spatialStreams));
+  phy.Set("MaxSupportedTxSpatialStreams", UintegerValue(profile.spatialStreams));
+  phy.Set("MaxSupportedRxSpatialStreams", UintegerValue(profile.spatialStreams));
+
+  NetDeviceContainer devices = wifi.Install(phy, mac, nodes);
+  for (uint32_t i = 0; i < devices.GetN(); i++)
+    {
+      Ptr<WifiNetDevice> dev = DynamicCast<WifiNetDevice>(devices.Get(i));
+      if (profile.standard == "80211ax")
+        dev->GetHeConfiguration()->SetAttribute("GuardInterval", TimeValue(NanoSeconds(profile.guardInterval)));
+      else
+        dev->GetHtConfiguration()->SetAttribute("ShortGuardIntervalSupported",
+                                                BooleanValue(profile.guardInterval == 400));
+      ConfigureAggregation(dev, aggregation);
+    }
+  return devices;
+}
+
+// Channels available to backhaul hops: the non-overlapping channels of the
+// relay width, the first of which is (or overlaps) the primary channel
+std::vector<uint16_t> BackhaulChannels()
+{
+  std::vector<uint16_t> channels = ChannelsForWidth(GetRadioProfile(g_config.relayRadio).channelWidth);
+  if (g_config.channelCount > 0 && g_config.channelCount < channels.size())
+    channels.resize(g_config.channelCount);
+  return channels;
+}
+
+// Channel of every backhaul hop (hops 1..N when the drones carry a second
+// radio) before the relay positions are known: alternate between the first
+// two channels
+std::vector<uint16_t> AlternateHopChannels(uint32_t nHops)
+{
+  std::vector<uint16_t> channels = BackhaulChannels();
+  std::vector<uint16_t> assignment(nHops, 0);
+  for (uint32_t h = 1; h < nHops; h++)
+    assignment[h] = channels[h % std::min<size_t>(2, channels.size())];
+  return assignment;
+}
+
+// Spatial-reuse channel assignment for the hops between consecutive points of
+// `path` (user, relays, AP). Hop 0 stays on the primary channel; every further
+// hop greedily takes the channel on which the hops already assigned would
+// couple the least power into it (strongest link between any of their ends,
+// summed in mW), so a channel is only reused by hops far enough apart.
+std::vector<uint16_t> ReuseHopChannels(const std::vector<Vector> &path, double txPowerDbm)
+{
+  std::vector<Ptr<MobilityModel>> points;
+  for (const Vector &pos : path)
+    {
+      Ptr<ConstantPositionMobilityModel> point = CreateObject<ConstantPositionMobilityModel>();
+      point->SetPosition(pos);
+      points.push_back(point);
+    }
+  auto coupling = [&](uint32_t g, uint32_t h) {
+    double strongest = -1000.0;
+    for (uint32_t a : {g, g + 1})
+      for (uint32_t b : {h, h + 1})
+        strongest = std::max(strongest, g_lossModel->CalcRxPower(txPowerDbm, points[a], points[b]));
+    return std::pow(10.0, strongest / 10.0);
+  };
+
+  std::vector<uint16_t> channels = BackhaulChannels();
+  uint32_t nHops = path.size() - 1;
+  std::vector<uint16_t> assignment(nHops, channels[0]);
+  for (uint32_t h = 1; h < nHops; h++)
+    {
+      double best = -1.0;
+      for (uint16_t channel : channels)
+        {
+          double interference = 0.0;
+          for (uint32_t g = 0; g < h; g++)
+            if (assignment[g] == channel)
+              interference += coupling(g, h);
+          if (best < 0 || interference < best)
+            {
+              best = interference;
+              assignment[h] = channel;
+            }
+        }
+    }
+  assignment[0] = 0;
+  return assignment;
+}
+
+// The user's STA: passive or active scanning, leaving the BSS after
+// maxMissedBeacons missed beacons
+void SetUserStaMac(WifiMacHelper &mac, const Ssid &ssid)
+{
+  mac.SetType("ns3::StaWifiMac",
+              "Ssid", SsidValue(ssid),
+              "ActiveProbing", BooleanValue(g_config.activeProbing),
+              "MaxMissedBeacons", UintegerValue(g_config.maxMissedBeacons));
+}
+
+// Access channel of bridged drone APs. Roaming users only scan their current
+// channel, so drones share the primary channel; with directed handover they
+// get their own and the controller moves the user onto it.
+uint16_t DroneAccessChannel()
+{
+  if (g_config.handover != "directed")
+    return 0;
+  return ChannelsForWidth(GetRadioProfile(g_config.relayRadio).channelWidth)[1];
+}
+
+// 802.11s mesh points; ns-3 only supports them on the non-HT 802.11a PHY
+MeshHelper CreateMeshHelper()
+{
+  MeshHelper meshHelper = MeshHelper::Default();
+  meshHelper.SetStandard(WIFI_STANDARD_80211a);
+  meshHelper.SetStackInstaller("ns3::Dot11sStack");
+  meshHelper.SetSpreadInterfaceChannels(MeshHelper::ZERO_CHANNEL);
+  meshHelper.SetRemoteStationManager("ns3::IdealWifiManager");
+  meshHelper.SetMacType("RandomStart", TimeValue(MilliSeconds(100)));
+  meshHelper.SetNumberOfInterfaces(1);
+  return meshHelper;
+}
+
+// Queue discs of a root that actually hold packets: the children of a
+// classful root (mq does not queue itself), or the root
+std::vector<Ptr<QueueDisc>> LeafQueueDiscs(Ptr<QueueDisc> root)
+{
+  std::vector<Ptr<QueueDisc>> leaves;
+  for (uint32_t c = 0; c < root->GetNQueueDiscClasses(); c++)
+    leaves.push_back(root->GetQueueDiscClass(c)->GetQueueDisc());
+  if (leaves.empty())
+    leaves.push_back(root);
+  return leaves;
+}
+
+// Replace the default root queue disc of every IP interface of the AP and the
+// relays with an mq root holding one queueDisc child per device transmit
+// queue (one per access category on QoS devices). Queue discs require
+// routed forwarding; main() rejects them with mesh or bridged forwarding.
+void InstallQueueDiscs(const Topology &topo)
+{
+  if (g_config.queueDisc == "default")
+    return;
+  std::string child = g_config.queueDisc == "pfifo"     ? "ns3::FifoQueueDisc"
+                      : g_config.queueDisc == "codel"   ? "ns3::CoDelQueueDisc"
+                      : g_config.queueDisc == "fqcodel" ? "ns3::FqCoDelQueueDisc"
+                                                        : "ns3::PieQueueDisc";
+  NodeContainer nodes(topo.ap, topo.relays);
+  for (uint32_t n = 0; n < nodes.GetN(); n++)
+    {
+      Ptr<TrafficControlLayer> tc = nodes.Get(n)->GetObject<TrafficControlLayer>();
+      for (uint32_t d = 0; d < nodes.Get(n)->GetNDevices(); d++)
+        {
+          Ptr<NetDevice> dev = nodes.Get(n)->GetDevice(d);
+          if (!tc->GetRootQueueDiscOnDevice(dev))
+            continue;
+          uint16_t nQueues = dev->GetObject<NetDeviceQueueInterface>()->GetNTxQueues();
+          TrafficControlHelper tch;
+          uint16_t handle = tch.SetRootQueueDisc("ns3::MqQueueDisc");
+          TrafficControlHelper::ClassIdList classes = tch.AddQueueDiscClasses(handle, nQueues, "ns3::QueueDiscClass");
+          tch.AddChildQueueDiscs(handle, classes, child);
+          tch.Uninstall(dev);
+          tch.Install(dev);
+        }
+    }
+}
+
+// Static routing (for routes the controller installs) below the dynamic
+// routing protocol of routed relays
+Ipv4ListRoutingHelper CreateRoutingHelper()
+{
+  Ipv4ListRoutingHelper list;
+  list.Add(Ipv4StaticRoutingHelper(), 0);
+  if (g_config.routing == "olsr")
+    list.Add(OlsrHelper(), 10);
+  else if (g_config.routing == "aodv")
+    list.Add(AodvHelper(), 10);
+  else if (g_config.routing == "dsdv")
+    list.Add(DsdvHelper(), 10);
+  else
+    NS_FATAL_ERROR("Unknown routing protocol \"" << g_config.routing << "\"");
+  return list;
+}
+
+// Install Wi-Fi, mobility and the IP stack on the topology's nodes. The
+// baseline is a single BSS (user STA + AP); relayed topologies run every
+// node in ad-hoc mode and forward over host routes (see InstallRelayRoutes).
+// With forwarding=mesh every node is instead an 802.11s mesh point on the
+// primary channel and HWMP finds the path at layer 2, so there are no hops
+// to route. With forwarding=bridged the user stays a STA and roams between
+// the AP and drones acting as repeater APs, bridged over a mesh backhaul.
+//
+// With single-radio relays every hop shares the primary channel and the
+// 10.1.1.0/24 network. With relayRadios=2, only the first drone joins the
+// primary network (as the user-facing radio); every further hop gets its
+// own channel and 10.1.<hop+1>.0/24 network between the second radio of one
+// node and the first radio of the next, the AP's second radio ending the chain.
+// Further cells on a shared channel use 10.<subnet>.* instead.
+void BuildNetwork(Topology &topo, bool adhoc)
+{
+  bool mesh = g_config.forwarding == "mesh";
+  bool bridged = g_config.forwarding == "bridged";
+  NS_ABORT_MSG_IF(!adhoc && !mesh && !bridged && topo.relays.GetN() > 0, "Routed relays need the ad-hoc network");
+  NS_ABORT_MSG_IF(g_config.relayRadios < 1 || g_config.relayRadios > 2, "Relays carry one or two radios");
+  NS_ABORT_MSG_IF((mesh || bridged) && g_config.relayRadios != 1, "Mesh and bridged relays have a fixed radio layout");
+  bool dualRadio = g_config.relayRadios == 2 && topo.relays.GetN() > 0;
+  uint32_t nHops = topo.relays.GetN() > 0 && !mesh && !bridged ? topo.relays.GetN() + 1 : 0;
+
+  // Channel + PHY
+  topo.phy.SetChannel(topo.channel ? topo.channel : CreateChannel());
+
+  WifiMacHelper mac;
+
+  if (mesh)
+    {
+      MeshHelper meshHelper = CreateMeshHelper();
+      topo.devices.Add(meshHelper.Install(topo.phy, topo.user));
+      topo.devices.Add(meshHelper.Install(topo.phy, topo.ap));
+      topo.devices.Add(meshHelper.Install(topo.phy, topo.relays));
+    }
+  else if (bridged)
+    {
+      // The user roams between the AP and drones repeating its SSID; each of
+      // them bridges its access radio onto an 802.11s backhaul (ns-3 has no
+      // 4-address STA to bridge over)
+      Ssid ssid("base-ap");
+      SetUserStaMac(mac, ssid);
+      topo.devices.Add(InstallRadio(topo, "user", mac, topo.user));
+
+      mac.SetType("ns3::ApWifiMac",
+                  "Ssid", SsidValue(ssid),
+                  "BeaconInterval", TimeValue(g_config.beaconInterval));
+      NodeContainer aps(topo.ap, topo.relays);
+      NetDeviceContainer access = InstallRadio(topo, "ap", mac, topo.ap);
+      access.Add(InstallRadio(topo, "relay", mac, topo.relays, DroneAccessChannel()));
+      NetDeviceContainer backhaul = CreateMeshHelper().Install(topo.phy, aps);
+      BridgeHelper bridge;
+      for (uint32_t i = 0; i < aps.GetN(); i++)
+        {
+          NetDeviceContainer bridgeDev = bridge.Install(aps.Get(i), NetDeviceContainer(access.Get(i), backhaul.Get(i)));
+          if (i == 0)
+            topo.devices.Add(bridgeDev); // only the AP's bridge gets an address
+        }
+    }
+  else if (adhoc)
+    {
+      mac.SetType("ns3::AdhocWifiMac");
+      topo.devices.Add(InstallRadio(topo, "user", mac, topo.user));
+      topo.devices.Add(InstallRadio(topo, "ap", mac, topo.ap));
+      if (dualRadio)
+        topo.devices.Add(InstallRadio(topo, "relay", mac, topo.relays.Get(0)));
+      else
+        topo.devices.Add(InstallRadio(topo, "relay", mac, topo.relays));
+    }
+  else
+    {
+      Ssid ssid("base-ap");
+      SetUserStaMac(mac, ssid);
+      topo.devices.Add(InstallRadio(topo, "user", mac, topo.user));
+
+      mac.SetType("ns3::ApWifiMac",
+                  "Ssid", SsidValue(ssid),
+                  "BeaconInterval", TimeValue(g_config.beaconInterval));
+      topo.devices.Add(InstallRadio(topo, "ap", mac, topo.ap));
+    }
+
+  // Chain: user, relays, AP. Single-radio hops reuse the primary devices.
+  std::vector<Ptr<Node>> path;
+  path.push_back(topo.user.Get(0));
+  for (uint32_t i = 0; i < topo.relays.GetN(); i++)
+    path.push_back(topo.relays.Get(i));
+  path.push_back(topo.ap.Get(0));
+
+  std::vector<uint16_t> channels = AlternateHopChannels(nHops);
+  std::vector<NetDeviceContainer> backhaul;
+  for (uint32_t h = 0; h < nHops; h++)
+    {
+      Hop hop;
+      hop.channel = channels[h];
+      if (h == 0 || !dualRadio)
+        {
+          hop.near = topo.devices.Get(h == 0 ? 0 : 2 + h - 1);
+          hop.far = topo.devices.Get(h + 1 == nHops ? 1 : 2 + h);
+          hop.channel = 0;
+        }
+      else
+        {
+          NetDeviceContainer pair = InstallRadio(topo, "relay", mac, NodeContainer(path[h], path[h + 1]), hop.channel);
+          backhaul.push_back(pair);
+          hop.near = pair.Get(0);
+          hop.far = pair.Get(1);
+        }
+      topo.hops.push_back(hop);
+    }
+  BuildMacTable();
+
+  g_nodeNames.clear();
+  g_nodeNames[topo.user.Get(0)->GetId()] = "user";
+  g_nodeNames[topo.ap.Get(0)->GetId()] = "ap";
+  for (uint32_t i = 0; i < topo.relays.GetN(); i++)
+    g_nodeNames[topo.relays.Get(i)->GetId()] = "relay" + std::to_string(i);
+
+  // Mobility
+  MobilityHelper mobility;
+  mobility.SetMobilityModel("ns3::ConstantVelocityMobilityModel");
+  mobility.Install(topo.user);
+  mobility.Install(topo.ap);
+  mobility.SetMobilityModel(topo.relayMobility);
+  mobility.Install(topo.relays);
+
+  InternetStackHelper stack;
+  if (g_config.forwarding == "routed" && g_config.routing != "static")
+    stack.SetRoutingHelper(CreateRoutingHelper());
+  stack.Install(topo.user);
+  stack.Install(topo.ap);
+  stack.Install(topo.relays);
+
+  Ipv4AddressHelper address;
+  std::string prefix = "10." + std::to_string(topo.subnet) + ".";
+  address.SetBase((prefix + "1.0").c_str(), "255.255.255.0");
+  topo.interfaces = address.Assign(topo.devices);
+  for (uint32_t i = 0; i < backhaul.size(); i++)
+    {
+      std::string network = prefix + std::to_string(i + 2) + ".0";
+      address.SetBase(network.c_str(), "255.255.255.0");
+      address.Assign(backhaul[i]);
+    }
+  InstallQueueDiscs(topo);
+}
+
+// With channelAssignment=reuse, retune the backhaul hops of a dual-radio
+// chain once the positions of its nodes (user, relays, AP) are known
+void AssignHopChannels(Topology &topo, const std::vector<Vector> &path)
+{
+  if (g_config.channelAssignment != "reuse" || g_config.relayRadios != 2 || topo.hops.size() < 2)
+    return;
+  Ptr<WifiPhy> phy = DynamicCast<WifiNetDevice>(topo.hops[1].near)->GetPhy();
+  std::vector<uint16_t> channels = ReuseHopChannels(path, phy->GetTxPowerStart());
+  uint16_t width = GetRadioProfile(g_config.relayRadio).channelWidth;
+  for (uint32_t h = 1; h < topo.hops.size(); h++)
+    {
+      Hop &hop = topo.hops[h];
+      if (hop.channel == channels[h])
+        continue;
+      hop.channel = channels[h];
+      std::ostringstream channelSettings;
+      channelSettings << "{" << hop.channel << ", " << width << ", BAND_5GHZ, 0}";
+      for (Ptr<NetDevice> dev : {hop.near, hop.far})
+        DynamicCast<WifiNetDevice>(dev)->GetPhy()->SetAttribute("ChannelSettings", StringValue(channelSettings.str()));
+    }
+}
+
+// Receiver minimum sensitivity (dBm) per MCS index at 20 MHz (802.11n/ac/ax
+// tables); every doubling of the width costs 3 dB
+const double MIN_SENSITIVITY_DBM[] = {-82, -79, -77, -74, -70, -66, -65, -64, -59, -57, -54, -52};
+
+// Link-budget power control: set the TX power of the AP's and the relays'
+// hop devices to the lowest that still delivers the sensitivity of
+// powerTargetMcs plus powerMargin at the far end of each of their hops, at
+// most the power they started with. Needs the node positions.
+void ApplyPowerControl(const Topology &topo)
+{
+  uint32_t mcs = std::min<uint32_t>(g_config.powerTargetMcs, std::size(MIN_SENSITIVITY_DBM) - 1);
+  std::map<Ptr<WifiPhy>, double> power;
+  for (const Hop &hop : topo.hops)
+    for (Ptr<NetDevice> from : {hop.near, hop.far})
+      {
+        Ptr<NetDevice> to = from == hop.near ? hop.far : hop.near;
+        if (from->GetNode() == topo.user.Get(0))
+          continue;
+        Ptr<WifiPhy> phy = DynamicCast<WifiNetDevice>(from)->GetPhy();
+        double target =
+            MIN_SENSITIVITY_DBM[mcs] + 3.0 * std::log2(phy->GetChannelWidth() / 20.0) + g_config.powerMargin;
+        // Path loss, from the power received for 0 dBm
+        double loss = -g_lossModel->CalcRxPower(0.0, from->GetNode()->GetObject<MobilityModel>(),
+                                                to->GetNode()->GetObject<MobilityModel>());
+        double needed = std::min(phy->GetTxPowerEnd(), target + loss);
+        auto it = power.find(phy);
+        power[phy] = it == power.end() ? needed : std::max(it->second, needed);
+      }
+  for (const auto &entry : power)
+    {
+      entry.first->SetTxPowerStart(entry.second);
+      entry.first->SetTxPowerEnd(entry.second);
+    }
+}
+
+// Route the user's traffic to the AP and back hop by hop along the chain
+void InstallRelayRoutes(const Topology &topo)
+{
+  Ipv4StaticRoutingHelper routingHelper;
+  for (const Hop &hop : topo.hops)
+    {
+      std::pair<Ipv4Address, uint32_t> near = GetDeviceAddress(hop.near);
+      std::pair<Ipv4Address, uint32_t> far = GetDeviceAddress(hop.far);
+      routingHelper.GetStaticRouting(hop.near->GetNode()->GetObject<Ipv4>())
+          ->AddHostRouteTo(topo.ApAddress(), far.first, near.second);
+      routingHelper.GetStaticRouting(hop.far->GetNode()->GetObject<Ipv4>())
+          ->AddHostRouteTo(topo.UserAddress(), near.first, far.second);
+    }
+}
+
+// Permanent ARP entry on `dev`'s interface for the address of `neighbour`
+void AddArpEntry(Ptr<NetDevice> dev, Ptr<NetDevice> neighbour)
+{
+  Ptr<Ipv4L3Protocol> ipv4 = dev->GetNode()->GetObject<Ipv4L3Protocol>();
+  Ptr<ArpCache> cache = ipv4->GetInterface(GetDeviceAddress(dev).second)->GetArpCache();
+  Ipv4Address address = GetDeviceAddress(neighbour).first;
+  ArpCache::Entry *entry = cache->Lookup(address);
+  if (!entry)
+    entry = cache->Add(address);
+  entry->SetMacAddress(neighbour->GetAddress());
+  entry->MarkPermanent();
+}
+
+// Resolve both ends of every hop in advance, so the first packets over a new
+// relay do not wait for ARP
+void PopulateHopArp(const Topology &topo)
+{
+  for (const Hop &hop : topo.hops)
+    {
+      AddArpEntry(hop.near, hop.far);
+      AddArpEntry(hop.far, hop.near);
+    }
+}
+
+// Remove the host routes InstallRelayRoutes added
+void RemoveRelayRoutes(const Topology &topo)
+{
+  Ipv4StaticRoutingHelper routingHelper;
+  for (const Hop &hop : topo.hops)
+    {
+      for (Ptr<NetDevice> dev : {hop.near, hop.far})
+        {
+          Ptr<Ipv4StaticRouting> routing = routingHelper.GetStaticRouting(dev->GetNode()->GetObject<Ipv4>());
+          for (uint32_t i = routing->GetNRoutes(); i-- > 0;)
+            {
+              Ipv4RoutingTableEntry route = routing->GetRoute(i);
+              if (route.IsHost() && (route.GetDest() == topo.ApAddress() || route.GetDest() == topo.UserAddress()))
+                routing->RemoveRoute(i);
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Queue instrumentation
+//
+// Every Wi-Fi device of the user, the AP and the relays keeps fixed-size
+// buffers: sojourn-time histograms of its Wi-Fi MAC queues (enqueue to
+// dequeue, i.e. until the MPDU is acknowledged or dropped) and of its
+// traffic-control queue discs, and a ring of periodic queue length samples.
+// ---------------------------------------------------------------------------
+
+// Bin k > 0 counts sojourns in [2^(k-1), 2^k) us, bin 0 those under 1 us
+const uint32_t SOJOURN_BINS = 24;
+// Queue length samples kept per device; covers a monitor interval at the
+// default sampling rate
+const uint32_t QUEUE_SAMPLES = 256;
+
+struct SojournHistogram
+{
+  std::array<uint64_t, SOJOURN_BINS> bins{};
+  uint64_t count = 0;
+  Time max;
+};
+
+void AddSojourn(SojournHistogram &hist, Time sojourn)
+{
+  int64_t us = sojourn.GetMicroSeconds();
+  uint32_t bin = 0;
+  while (bin + 1 < SOJOURN_BINS && us >= ((int64_t)1 << bin))
+    bin++;
+  hist.bins[bin]++;
+  hist.count++;
+  hist.max = std::max(hist.max, sojourn);
+}
+
+void MergeSojourn(SojournHistogram &into, const SojournHistogram &from)
+{
+  for (uint32_t bin = 0; bin < SOJOURN_BINS; bin++)
+    into.bins[bin] += from.bins[bin];
+  into.count += from.count;
+  into.max = std::max(into.max, from.max);
+}
+
+// Upper edge (s) of the bin holding quantile q, capped at the largest sojourn
+double SojournPercentile(const SojournHistogram &hist, double q)
+{
+  uint64_t rank = std::max<uint64_t>(1, std::ceil(q * hist.count));
+  uint64_t seen = 0;
+  for (uint32_t bin = 0; bin < SOJOURN_BINS && hist.count > 0; bin++)
+    {
+      seen += hist.bins[bin];
+      if (seen >= rank)
+        return std::min(std::ldexp(1e-6, bin), hist.max.GetSeconds());
+    }
+  return hist.max.GetSeconds();
+}
+
+struct DeviceQueueStats
+{
+  std::string name; // node name / device index
+  std::vector<Ptr<WifiMacQueue>> macQueues;
+  std::vector<Ptr<QueueDisc>> queueDiscs; // leaves of the root queue disc, if any
+  SojournHistogram macSojourn;
+  SojournHistogram tcSojourn;
+  std::array<uint32_t, QUEUE_SAMPLES> macLength{};
+  std::array<uint32_t, QUEUE_SAMPLES> tcLength{};
+  uint64_t samples = 0;  // taken so far; the ring holds the last QUEUE_SAMPLES
+  uint64_t reported = 0; // samples already covered by a report
+};
+
+// (node id, device index) -> queue statistics
+std::map<std::pair<uint32_t, uint32_t>, DeviceQueueStats> g_queueStats;
+
+void MacDequeueTrace(DeviceQueueStats *stats, Ptr<const WifiMpdu> mpdu)
+{
+  AddSojourn(stats->macSojourn, Simulator::Now() - mpdu->GetTimestamp());
+}
+
+void TcSojournTrace(DeviceQueueStats *stats, Time sojourn)
+{
+  AddSojourn(stats->tcSojourn, sojourn);
+}
+
+void SampleQueues(Time interval)
+{
+  for (auto &entry : g_queueStats)
+    {
+      DeviceQueueStats &stats = entry.second;
+      uint32_t mac = 0;
+      for (Ptr<WifiMacQueue> queue : stats.macQueues)
+        mac += queue->GetNPackets();
+      uint32_t tc = 0;
+      for (Ptr<QueueDisc> queueDisc : stats.queueDiscs)
+        tc += queueDisc->GetNPackets();
+      stats.macLength[stats.samples % QUEUE_SAMPLES] = mac;
+      stats.tcLength[stats.samples % QUEUE_SAMPLES] = tc;
+      stats.samples++;
+    }
+  Simulator::Schedule(interval, &SampleQueues, interval);
+}
+
+// Hook every Wi-Fi device of the topology and start sampling
+void EnableQueueTracing(const Topology &topo)
+{
+  g_queueStats.clear();
+  NodeContainer nodes(topo.user, topo.ap, topo.relays);
+  for (uint32_t n = 0; n < nodes.GetN(); n++)
+    {
+      Ptr<Node> node = nodes.Get(n);
+      Ptr<TrafficControlLayer> tc = node->GetObject<TrafficControlLayer>();
+      for (uint32_t d = 0; d < node->GetNDevices(); d++)
+        {
+          Ptr<WifiNetDevice> dev = DynamicCast<WifiNetDevice>(node->GetDevice(d));
+          if (!dev)
+            continue;
+          DeviceQueueStats &stats = g_queueStats[std::make_pair(node->GetId(), d)];
+          stats.name = NodeName(node->GetId()) + "/" + std::to_string(d);
+
+          Ptr<WifiMac> mac = dev->GetMac();
+          if (mac->GetQosSupported())
+            for (AcIndex ac : {AC_BE, AC_BK, AC_VI, AC_VO})
+              stats.macQueues.push_back(mac->GetTxopQueue(ac));
+          else
+            stats.macQueues.push_back(mac->GetTxopQueue(AC_BE_NQOS));
+          for (Ptr<WifiMacQueue> queue : stats.macQueues)
+            queue->TraceConnectWithoutContext("Dequeue", MakeBoundCallback(&MacDequeueTrace, &stats));
+
+          Ptr<QueueDisc> root = tc ? tc->GetRootQueueDiscOnDevice(dev) : nullptr;
+          if (root)
+            stats.queueDiscs = LeafQueueDiscs(root);
+          for (Ptr<QueueDisc> queueDisc : stats.queueDiscs)
+            queueDisc->TraceConnectWithoutContext("SojournTime", MakeBoundCallback(&TcSojournTrace, &stats));
+        }
+    }
+  Simulator::Schedule(g_config.queueSampleInterval, &SampleQueues, g_config.queueSampleInterval);
+}
+
+// Start a new reporting interval
+void ResetQueueStats()
+{
+  for (auto &entry : g_queueStats)
+    {
+      entry.second.macSojourn = SojournHistogram();
+      entry.second.tcSojourn = SojournHistogram();
+      entry.second.reported = entry.second.samples;
+    }
+}
+
+// Traffic-control sojourn histogram of all devices of a node
+SojournHistogram NodeTcSojourn(uint32_t node)
+{
+  SojournHistogram hist;
+  for (const auto &entry : g_queueStats)
+    if (entry.first.first == node)
+      MergeSojourn(hist, entry.second.tcSojourn);
+  return hist;
+}
+
+// Print every device's mean and peak MAC and traffic-control queue lengths
+// and sojourn percentiles since the last report, name the most occupied
+// queue, then start a new interval
+void ReportQueues()
+{
+  std::string congested;
+  double worst = 0.0;
+  for (auto &entry : g_queueStats)
+    {
+      const DeviceQueueStats &stats = entry.second;
+      uint64_t n = std::min<uint64_t>(stats.samples - stats.reported, QUEUE_SAMPLES);
+      double macMean = 0.0;
+      double tcMean = 0.0;
+      uint32_t macPeak = 0;
+      uint32_t tcPeak = 0;
+      for (uint64_t i = stats.samples - n; i < stats.samples; i++)
+        {
+          macMean += stats.macLength[i % QUEUE_SAMPLES];
+          tcMean += stats.tcLength[i % QUEUE_SAMPLES];
+          macPeak = std::max(macPeak, stats.macLength[i % QUEUE_SAMPLES]);
+          tcPeak = std::max(tcPeak, stats.tcLength[i % QUEUE_SAMPLES]);
+        }
+      if (n > 0)
+        {
+          macMean /= n;
+          tcMean /= n;
+        }
+      if (!g_config.quiet && (macPeak > 0 || tcPeak > 0 || stats.macSojourn.count > 0))
+        std::cout << "  " << stats.name << " queue: MAC " << macMean << " avg/" << macPeak << " peak, TC " << tcMean
+                  << " avg/" << tcPeak << " peak; sojourn MAC median "
+                  << 1000.0 * SojournPercentile(stats.macSojourn, 0.5) << " ms p99 "
+                  << 1000.0 * SojournPercentile(stats.macSojourn, 0.99) << " ms, TC median "
+                  << 1000.0 * SojournPercentile(stats.tcSojourn, 0.5) << " ms p99 "
+                  << 1000.0 * SojournPercentile(stats.tcSojourn, 0.99) << " ms" << std::endl;
+      if (macMean + tcMean > worst)
+        {
+          worst = macMean + tcMean;
+          congested = stats.name;
+        }
+    }
+  if (!g_config.quiet && worst >= 1.0)
+    std::cout << "  most congested queue: " << congested << " (" << worst << " packets on average)" << std::endl;
+  ResetQueueStats();
+}
+
+// ---------------------------------------------------------------------------
+// Loss causes
+//
+// Every drop in the stack is counted under a cause: PHY reception failures
+// of data frames addressed to the receiver (by WifiPhyRxfailureReason, plus
+// payload decode failures as "phy:payload"), MAC
+// drops (retry limit, queue overflow, lifetime, not associated), queue disc
+// drops, IP drops (no route, TTL) and unresolved ARP. Causes a relay can fix
+// (weak or broken links) are kept apart from congestion and the rest.
+// ---------------------------------------------------------------------------
+
+struct LossCause
+{
+  uint64_t count = 0;
+  bool fixable = false;
+};
+
+// Cause -> drops in the current monitor interval
+std::map<std::string, LossCause> g_lossCauses;
+
+void RecordLoss(const std::string &cause, bool fixable)
+{
+  LossCause &loss = g_lossCauses[cause];
+  loss.count++;
+  loss.fixable = fixable;
+}
+
+void LossPhyRxDropTrace(Mac48Address receiver, Ptr<const Packet> p, WifiPhyRxfailureReason reason)
+{
+  WifiMacHeader hdr;
+  if (!PeekDataHeader(p, hdr) || hdr.GetAddr1() != receiver)
+    return;
+  std::ostringstream cause;
+  cause << "phy:" << reason;
+  bool fixable;
+  switch (reason)
+    {
+    // The receiver's own state: would happen with a relay too
+    case TXING:
+    case SLEEPING:
+    case POWERED_OFF:
+    case CHANNEL_SWITCHING:
+    // Contention: another frame was on the air, which a relay adds to
+    case RXING:
+    case BUSY_DECODING_PREAMBLE:
+    case FRAME_CAPTURE_PACKET_SWITCH:
+    case PREAMBLE_DETECTION_PACKET_SWITCH:
+    case RECEPTION_ABORTED_BY_TX:
+      fixable = false;
+      break;
+    default:
+      fixable = true;
+      break;
+    }
+  RecordLoss(cause.str(), fixable);
+}
+
+// Payload decode failures (preamble and header received): a weak link
+void LossRxErrorTrace(Mac48Address receiver, Ptr<const Packet> p, double snr)
+{
+  WifiMacHeader hdr;
+  if (PeekDataHeader(p, hdr) && hdr.GetAddr1() == receiver)
+    RecordLoss("phy:payload", true);
+}
+
+void LossMacTxDropTrace(Ptr<const Packet> p)
+{
+  // Packets the MAC cannot send at all, e.g. from a STA that is not associated
+  RecordLoss("mac:not-sent", true);
+}
+
+void LossDroppedMpduTrace(WifiMacDropReason reason, Ptr<const WifiMpdu> mpdu)
+{
+  if (!mpdu->GetHeader().IsData())
+    return;
+  switch (reason)
+    {
+    case WIFI_MAC_DROP_REACHED_RETRY_LIMIT:
+      RecordLoss("mac:retry-limit", true);
+      break;
+    case WIFI_MAC_DROP_FAILED_ENQUEUE:
+      RecordLoss("mac:queue-overflow", false);
+      break;
+    case WIFI_MAC_DROP_EXPIRED_LIFETIME:
+      RecordLoss("mac:lifetime-expired", false);
+      break;
+    default:
+      RecordLoss("mac:other", false);
+      break;
+    }
+}
+
+void LossQueueDiscDropTrace(Ptr<const QueueDiscItem> item)
+{
+  RecordLoss("tc:drop", false);
+}
+
+void LossIpDropTrace(const Ipv4Header &header, Ptr<const Packet> p, Ipv4L3Protocol::DropReason reason,
+                     Ptr<Ipv4> ipv4, uint32_t ifIndex)
+{
+  if (reason == Ipv4L3Protocol::DROP_NO_ROUTE)
+    RecordLoss("ip:no-route", false);
+  else if (reason == Ipv4L3Protocol::DROP_TTL_EXPIRED)
+    RecordLoss("ip:ttl-expired", false);
+  else
+    RecordLoss("ip:other", false);
+}
+
+void LossArpDropTrace(Ptr<const Packet> p)
+{
+  // The neighbour did not answer (or too many packets waited for it)
+  RecordLoss("arp:unresolved", true);
+}
+
+void EnableLossTracing()
+{
+  g_lossCauses.clear();
+  for (NodeList::Iterator it = NodeList::Begin(); it != NodeList::End(); ++it)
+    {
+      Ptr<Node> node = *it;
+      Ptr<TrafficControlLayer> tc = node->GetObject<TrafficControlLayer>();
+      for (uint32_t i = 0; i < node->GetNDevices(); i++)
+        {
+          Ptr<NetDevice> dev = node->GetDevice(i);
+          Ptr<WifiNetDevice> wifi = DynamicCast<WifiNetDevice>(dev);
+          if (wifi)
+            {
+              Mac48Address address = Mac48Address::ConvertFrom(wifi->GetAddress());
+              wifi->GetPhy()->TraceConnectWithoutContext("PhyRxDrop", MakeBoundCallback(&LossPhyRxDropTrace, address));
+              wifi->GetPhy()->GetState()->TraceConnectWithoutContext("RxError",
+                                                                     MakeBoundCallback(&LossRxErrorTrace, address));
+              wifi->GetMac()->TraceConnectWithoutContext("MacTxDrop", MakeCallback(&LossMacTxDropTrace));
+              wifi->GetMac()->TraceConnectWithoutContext("DroppedMpdu", MakeCallback(&LossDroppedMpduTrace));
+            }
+          Ptr<QueueDisc> root = tc ? tc->GetRootQueueDiscOnDevice(dev) : nullptr;
+          if (root)
+            for (Ptr<QueueDisc> queueDisc : LeafQueueDiscs(root))
+              queueDisc->TraceConnectWithoutContext("Drop", MakeCallback(&LossQueueDiscDropTrace));
+        }
+      Ptr<Ipv4L3Protocol> ipv4 = node->GetObject<Ipv4L3Protocol>();
+      if (ipv4)
+        ipv4->TraceConnectWithoutContext("Drop", MakeCallback(&LossIpDropTrace));
+      Ptr<ArpL3Protocol> arp = node->GetObject<ArpL3Protocol>();
+      if (arp)
+        arp->TraceConnectWithoutContext("Drop", MakeCallback(&LossArpDropTrace));
+    }
+}
+
+// Print the drops of the last interval by cause, then reset. Returns the
+// {fixable, other} totals.
+std::pair<uint64_t, uint64_t> ReportLossCauses()
+{
+  uint64_t fixable = 0;
+  uint64_t other = 0;
+  std::ostringstream line;
+  for (const auto &entry : g_lossCauses)
+    {
+      (entry.second.fixable ? fixable : other) += entry.second.count;
+      line << " " << entry.first << "=" << entry.second.count;
+    }
+  if (!g_config.quiet && !g_lossCauses.empty())
+    std::cout << "  drops:" << line.str() << " (" << fixable << " a relay can fix, " << other << " other)"
+              << std::endl;
+  g_lossCauses.clear();
+  return std::make_pair(fixable, other);
+}
+
+// ---------------------------------------------------------------------------
+// PHY state accounting
+//
+// The WifiPhyStateHelper "State" trace reports every period a PHY spent in
+// one state. Time in TX, RX, CCA-busy and idle is summed per PHY over each
+// reporting interval and aggregated per channel, showing how much airtime
+// every hop consumes and which channel is closest to saturation. Idle,
+// CCA-busy and RX periods are only logged when they end and TX periods when
+// they start, so every share is taken over the periods clipped to the
+// interval plus the period still open at its end.
+// ---------------------------------------------------------------------------
+
+struct PhyStateTime
+{
+  std::string name; // node name / device index
+  Ptr<WifiPhy> phy;
+  Time tx;
+  Time rx;
+  Time ccaBusy;
+  Time idle;
+  Time loggedUntil;                              // end of the latest period logged
+  WifiPhyState loggedState = WifiPhyState::IDLE; // state of that period
+};
+
+// Time counter of `state`, null for states not reported
+Time *PhyStateBucket(PhyStateTime &states, WifiPhyState state)
+{
+  switch (state)
+    {
+    case WifiPhyState::TX:
+      return &states.tx;
+    case WifiPhyState::RX:
+      return &states.rx;
+    case WifiPhyState::CCA_BUSY:
+      return &states.ccaBusy;
+    case WifiPhyState::IDLE:
+      return &states.idle;
+    default:
+      return nullptr;
+    }
+}
+
+// (node id, device index) -> time per state in the current interval
+std::map<std::pair<uint32_t, uint32_t>, PhyStateTime> g_phyStates;
+Time g_phyStatesSince;
+
+void PhyStateTrace(PhyStateTime *states, Time start, Time duration, WifiPhyState state)
+{
+  // Only count the part of the period inside the current interval; the part
+  // before it was counted as open when that interval ended
+  Time from = std::max(start, g_phyStatesSince);
+  if (start + duration <= from)
+    return;
+  if (start + duration > states->loggedUntil)
+    {
+      states->loggedUntil = start + duration;
+      states->loggedState = state;
+    }
+  if (Time *bucket = PhyStateBucket(*states, state))
+    *bucket += start + duration - from;
+}
+
+// Times of `states` up to now: a period logged past now (a TX in progress)
+// is cut back to now, and the period not logged yet is counted in the
+// PHY's current state
+PhyStateTime PhyStatesUntilNow(const PhyStateTime &states)
+{
+  PhyStateTime clipped = states;
+  Time now = Simulator::Now();
+  Time open = states.loggedUntil - now;
+  WifiPhyState state = states.loggedState;
+  if (open < Time())
+    {
+      open = now - std::max(states.loggedUntil, g_phyStatesSince);
+      state = states.phy->GetState()->GetState();
+    }
+  else
+    open = -open;
+  if (Time *bucket = PhyStateBucket(clipped, state))
+    *bucket += open;
+  return clipped;
+}
+
+void EnablePhyStateTracing(const Topology &topo)
+{
+  g_phyStates.clear();
+  g_phyStatesSince = Simulator::Now();
+  NodeContainer nodes(topo.user, topo.ap, topo.relays);
+  for (uint32_t n = 0; n < nodes.GetN(); n++)
+    {
+      Ptr<Node> node = nodes.Get(n);
+      for (uint32_t d = 0; d < node->GetNDevices(); d++)
+        {
+          Ptr<WifiNetDevice> dev = DynamicCast<WifiNetDevice>(node->GetDevice(d));
+          if (!dev)
+            continue;
+          PhyStateTime &states = g_phyStates[std::make_pair(node->GetId(), d)];
+          states.name = NodeName(node->GetId()) + "/" + std::to_string(d);
+          states.phy = dev->GetPhy();
+          states.phy->GetState()->TraceConnectWithoutContext("State", MakeBoundCallback(&PhyStateTrace, &states));
+        }
+    }
+}
+
+void ResetPhyStates()
+{
+  Time now = Simulator::Now();
+  for (auto &entry : g_phyStates)
+    {
+      // Carry the rest of a period logged past now into the new interval
+      PhyStateTime &states = entry.second;
+      states.tx = states.rx = states.ccaBusy = states.idle = Time();
+      if (states.loggedUntil > now)
+        if (Time *bucket = PhyStateBucket(states, states.loggedState))
+          *bucket = states.loggedUntil - now;
+    }
+  g_phyStatesSince = now;
+}
+
+// Per channel over the current interval: {share of the interval spent
+// transmitting, summed over its PHYs; busy share (TX, RX or CCA-busy) of its
+// busiest PHY}. A busiest PHY near 1 means the channel is saturated there.
+std::map<uint16_t, std::pair<double, double>> ChannelUtilization()
+{
+  std::map<uint16_t, std::pair<double, double>> channels;
+  double interval = (Simulator::Now() - g_phyStatesSince).GetSeconds();
+  if (interval <= 0)
+    return channels;
+  for (const auto &entry : g_phyStates)
+    {
+      PhyStateTime states = PhyStatesUntilNow(entry.second);
+      std::pair<double, double> &channel = channels[states.phy->GetChannelNumber()];
+      channel.first += states.tx.GetSeconds() / interval;
+      channel.second = std::max(channel.second, (states.tx + states.rx + states.ccaBusy).GetSeconds() / interval);
+    }
+  return channels;
+}
+
+// Print every PHY's state shares and the per-channel utilization since the
+// last report, then start a new interval
+void ReportPhyStates()
+{
+  double interval = (Simulator::Now() - g_phyStatesSince).GetSeconds();
+  if (!g_config.quiet && interval > 0)
+    {
+      for (const auto &entry : g_phyStates)
+        {
+          PhyStateTime states = PhyStatesUntilNow(entry.second);
+          std::cout << "  " << states.name << " ch " << +states.phy->GetChannelNumber() << ": TX "
+                    << 100.0 * states.tx.GetSeconds() / interval << "%, RX "
+                    << 100.0 * states.rx.GetSeconds() / interval << "%, CCA-busy "
+                    << 100.0 * states.ccaBusy.GetSeconds() / interval << "%, idle "
+                    << 100.0 * states.idle.GetSeconds() / interval << "%" << std::endl;
+        }
+      for (const auto &entry : ChannelUtilization())
+        std::cout << "  channel " << entry.first << ": " << 100.0 * entry.second.first
+                  << "% transmitting, busiest PHY " << 100.0 * entry.second.second << "% busy" << std::endl;
+    }
+  ResetPhyStates();
+}
+
+// ---------------------------------------------------------------------------
+// Static snapshot probes
+//
+// A probe places the user, the AP and any relays at fixed positions, offers a
+// saturating UDP load from the user to the AP and reports the goodput. Every
+// probe is a separate simulation, so independent probes are run in parallel
+// in forked processes (the ns-3 simulator is a per-process singleton).
+// ---------------------------------------------------------------------------
+
+// Point `fraction` of the way from the AP (at the origin) to `userPos`
+Vector AlongLine(const Vector &userPos, double fraction)
+{
+  return Vector(userPos.x * fraction, userPos.y * fraction, userPos.z * fraction);
+}
+
+// Relay position `fraction` of the way from the AP to the user, hovering at `altitude`
+Vector RelayAt(const Vector &userPos, double fraction, double altitude)
+{
+  Vector pos = AlongLine(userPos, fraction);
+  pos.z = altitude;
+  return pos;
+}
+
+// Positions of `nRelays` relays evenly spaced between the user and the AP at
+// droneAltitude, ordered from the user towards the AP
+std::vector<Vector> EvenlySpacedRelays(const Vector &userPos, uint32_t nRelays)
+{
+  std::vector<Vector> positions;
+  for (uint32_t i = 0; i < nRelays; i++)
+    positions.push_back(RelayAt(userPos, (double)(nRelays - i) / (nRelays + 1), g_config.droneAltitude));
+  return positions;
+}
+
+// Altitudes tried when optimising a relay's placement
+std::vector<double> PlacementAltitudes()
+{
+  std::vector<double> altitudes = ParseList(g_config.placementAltitudes);
+  if (altitudes.empty())
+    altitudes.push_back(g_config.droneAltitude);
+  return altitudes;
+}
+
+// Airtime of every hop: transmit time of all frames (data, ACKs, Block Acks)
+// sent from one end of the hop to the other while g_countAirtime is set
+std::map<std::pair<Mac48Address, Mac48Address>, uint32_t> g_hopOfLink; // (tx, rx) -> hop
+std::vector<Time> g_hopAirtime;
+bool g_countAirtime = false;
+
+void HopTxTrace(Mac48Address tx, WifiConstPsduMap psdus, WifiTxVector txVector, double txPowerW)
+{
+  if (!g_countAirtime)
+    return;
+  auto it = g_hopOfLink.find(std::make_pair(tx, psdus.begin()->second->GetAddr1()));
+  if (it != g_hopOfLink.end())
+    g_hopAirtime[it->second] += WifiPhy::CalculateTxDuration(psdus, txVector, WIFI_PHY_BAND_5GHZ);
+}
+
+void EnableAirtimeTracing(const Topology &topo)
+{
+  g_hopOfLink.clear();
+  g_hopAirtime.assign(topo.hops.size(), Time());
+  g_countAirtime = false;
+  std::set<Ptr<NetDevice>> connected; // single-radio relays use one device for two hops
+  for (uint32_t h = 0; h < topo.hops.size(); h++)
+    {
+      Mac48Address near = Mac48Address::ConvertFrom(topo.hops[h].near->GetAddress());
+      Mac48Address far = Mac48Address::ConvertFrom(topo.hops[h].far->GetAddress());
+      g_hopOfLink[std::make_pair(near, far)] = h;
+      g_hopOfLink[std::make_pair(far, near)] = h;
+      for (Ptr<NetDevice> dev : {topo.hops[h].near, topo.hops[h].far})
+        if (connected.insert(dev).second)
+          DynamicCast<WifiNetDevice>(dev)->GetPhy()->TraceConnectWithoutContext(
+              "PhyTxPsduBegin", MakeBoundCallback(&HopTxTrace, Mac48Address::ConvertFrom(dev->GetAddress())));
+    }
+}
+
+// Measured share of the airtime and channel of one hop of a probe (see
+// ChannelUtilization for the per-channel view, valid until the next probe)
+struct HopReport
+{
+  double airtime; // fraction of the measured time
+  uint16_t channel; // 0 for the primary channel
+};
+
+// Per-channel utilization measured by the last probe
+std::map<uint16_t, std::pair<double, double>> g_channelUtilization;
+
+// Goodput (Mbit/s) of a saturating user->AP flow with the AP at the origin,
+// the user at `userPos` and relays at `relayPos` (ordered from the user).
+// `hops`, if given, receives the airtime and channel of every hop.
+double MeasureGoodput(const Vector &userPos, const std::vector<Vector> &relayPos,
+                      std::vector<HopReport> *hops = nullptr)
+{
+  Topology topo;
+  topo.ap.Create(1);
+  topo.user.Create(1);
+  topo.relays.Create(relayPos.size());
+  BuildNetwork(topo, true);
+  InstallRelayRoutes(topo);
+  if (g_config.prepopulateArp)
+    PopulateHopArp(topo);
+
+  topo.ap.Get(0)->GetObject<MobilityModel>()->SetPosition(Vector(0.0, 0.0, 0.0));
+  topo.user.Get(0)->GetObject<MobilityModel>()->SetPosition(userPos);
+  for (uint32_t i = 0; i < relayPos.size(); i++)
+    topo.relays.Get(i)->GetObject<MobilityModel>()->SetPosition(relayPos[i]);
+
+  std::vector<Vector> path(1, userPos);
+  path.insert(path.end(), relayPos.begin(), relayPos.end());
+  path.push_back(Vector(0.0, 0.0, 0.0));
+  AssignHopChannels(topo, path);
+  if (g_config.powerControl)
+    ApplyPowerControl(topo);
+  EnableAirtimeTracing(topo);
+  EnableQueueTracing(topo);
+  EnablePhyStateTracing(topo);
+
+  uint16_t port = 9;
+  Time stop = g_config.probeWarmup + g_config.probeTime;
+  PacketSinkHelper sinkHelper("ns3::UdpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), port));
+  ApplicationContainer sinkApps = sinkHelper.Install(topo.ap.Get(0));
+  sinkApps.Start(Seconds(0.0));
+  sinkApps.Stop(stop);
+
+  OnOffHelper source("ns3::UdpSocketFactory", InetSocketAddress(topo.ApAddress(), port));
+  source.SetConstantRate(DataRate(g_config.probeRate), 1024);
+  ApplicationContainer sourceApps = source.Install(topo.user.Get(0));
+  sourceApps.Start(Seconds(0.1));
+  sourceApps.Stop(stop);
+
+  // Only count what arrives after the warm-up (ARP, rate control settling)
+  Ptr<PacketSink> sink = DynamicCast<PacketSink>(sinkApps.Get(0));
+  uint64_t warmupBytes = 0;
+  Simulator::Schedule(g_config.probeWarmup, [&]() {
+    warmupBytes = sink->GetTotalRx();
+    g_countAirtime = true;
+    ResetQueueStats();
+    ResetPhyStates();
+  });
+
+  Simulator::Stop(stop);
+  Simulator::Run();
+  double goodput = (sink->GetTotalRx() - warmupBytes) * 8.0 / g_config.probeTime.GetSeconds() / 1e6;
+  if (hops)
+    for (uint32_t h = 0; h < topo.hops.size(); h++)
+      hops->push_back({g_hopAirtime[h].GetSeconds() / g_config.probeTime.GetSeconds(), topo.hops[h].channel});
+  g_channelUtilization = ChannelUtilization();
+  Simulator::Destroy();
+  return goodput;
+}
+
+// Goodput improvement of relaying over the direct link, in percent
+double RelayGain(double direct, double relayed)
+{
+  return direct > 0 ? 100.0 * (relayed - direct) / direct : 0.0;
+}
+
+// Run job(0) .. job(nJobs - 1), up to g_config.jobs at a time, each in its own
+// forked process, and collect the values every job returns
+std::vector<std::vector<double>> RunParallel(uint32_t nJobs, const std::function<std::vector<double>(uint32_t)> &job)
+{
+  std::vector<std::vector<double>> results(nJobs);
+  std::map<pid_t, std::pair<uint32_t, int>> running; // pid -> (job, read end of its pipe)
+  uint32_t next = 0;
+
+  while (next < nJobs || !running.empty())
+    {
+      if (next < nJobs && running.size() < g_config.jobs)
+        {
+          int fds[2];
+          NS_ABORT_MSG_IF(pipe(fds) != 0, "pipe() failed");
+          std::cout.flush();
+          pid_t pid = fork();
+          NS_ABORT_MSG_IF(pid < 0, "fork() failed");
+          if (pid == 0)
+            {
+              close(fds[0]);
+              std::vector<double> values = job(next);
+              uint32_t n = values.size();
+              // Results are a handful of doubles, well below the pipe buffer size
+              if (write(fds[1], &n, sizeof(n)) != (ssize_t)sizeof(n) ||
+                  write(fds[1], values.data(), n * sizeof(double)) != (ssize_t)(n * sizeof(double)))
+                _exit(1);
+              _exit(0);
+            }
+          close(fds[1]);
+          running[pid] = std::make_pair(next++, fds[0]);
+          continue;
+        }
+
+      int status;
+      pid_t pid = wait(&status);
+      auto it = running.find(pid);
+      if (it == running.end())
+        continue;
+      uint32_t index = it->second.first;
+      int fd = it->second.second;
+      uint32_t n = 0;
+      NS_ABORT_MSG_IF(!WIFEXITED(status) || WEXITSTATUS(status) != 0 || read(fd, &n, sizeof(n)) != (ssize_t)sizeof(n),
+                      "Probe job " << index << " failed");
+      results[index].resize(n);
+      NS_ABORT_MSG_IF(read(fd, results[index].data(), n * sizeof(double)) != (ssize_t)(n * sizeof(double)),
+                      "Probe job " << index << " returned a short result");
+      close(fd);
+      running.erase(it);
+    }
+  return results;
+}
+
+// Locate the user distance at which relaying starts to beat the direct link.
+// Each round probes several distances inside the bracketing interval in
+// parallel (direct and relayed at each) and keeps the sub-interval where the
+// relay gain changes sign. The first round always runs and also probes both
+// endpoints, so even an interval already within tolerance is checked.
+void RunCrossover()
+{
+  double lo = g_config.crossoverMin;
+  double hi = g_config.crossoverMax;
+  uint32_t points = std::max(1u, g_config.jobs / 2);
+  bool firstRound = true;
+
+  std::cout << "Crossover search with " << g_config.relays << " relay(s) in [" << lo << ", " << hi << "] m" << std::endl;
+  while (firstRound || hi - lo > g_config.crossoverTolerance)
+    {
+      std::vector<double> distances;
+      if (firstRound)
+        distances.push_back(lo);
+      for (uint32_t k = 1; k <= points; k++)
+        distances.push_back(lo + (hi - lo) * k / (points + 1));
+      if (firstRound)
+        distances.push_back(hi);
+
+      std::vector<std::vector<double>> results =
+          RunParallel(2 * distances.size(), [&](uint32_t job) {
+            Vector userPos(distances[job / 2], 0.0, 0.0);
+            uint32_t nRelays = job % 2 ? g_config.relays : 0;
+            return std::vector<double>{MeasureGoodput(userPos, EvenlySpacedRelays(userPos, nRelays))};
+          });
+
+      std::vector<bool> relayWins;
+      for (size_t i = 0; i < distances.size(); i++)
+        {
+          double direct = results[2 * i][0];
+          double relayed = results[2 * i + 1][0];
+          relayWins.push_back(relayed > direct);
+          std::cout << "  d=" << distances[i] << "m: direct=" << direct << " Mbps, relayed=" << relayed
+                    << " Mbps (relay gain " << RelayGain(direct, relayed) << "%)" << std::endl;
+        }
+
+      if (firstRound)
+        {
+          if (relayWins.front() || !relayWins.back())
+            {
+              std::cout << "No crossover inside [" << lo << ", " << hi << "] m" << std::endl;
+              return;
+            }
+          distances.erase(distances.begin());
+          relayWins.erase(relayWins.begin());
+          distances.pop_back();
+          relayWins.pop_back();
+          firstRound = false;
+        }
+
+      // Narrow to the first interval where the relay goes from losing to winning
+      double newLo = lo;
+      double newHi = hi;
+      for (size_t i = 0; i < distances.size(); i++)
+        {
+          if (relayWins[i])
+            {
+              newHi = distances[i];
+              break;
+            }
+          newLo = distances[i];
+        }
+      lo = newLo;
+      hi = newHi;
+    }
+
+  std::cout << "Crossover distance: " << (lo + hi) / 2 << " m (+/- " << (hi - lo) / 2 << " m)" << std::endl;
+}
+
+// Evaluate one heatmap cell: direct goodput, the best single relay over the
+// candidate positions on the AP-user line and candidate altitudes, and two
+// evenly spaced relays. Returns {direct, one relay, best relay fraction,
+// two relays, best relay altitude}.
+std::vector<double> EvaluateCell(const Vector &userPos)
+{
+  double direct = MeasureGoodput(userPos, {});
+
+  double oneRelay = 0.0;
+  double bestFraction = 0.0;
+  double bestAltitude = 0.0;
+  for (double altitude : PlacementAltitudes())
+    {
+      for (uint32_t k = 1; k <= g_config.placementSteps; k++)
+        {
+          double fraction = (double)k / (g_config.placementSteps + 1);
+          double goodput = MeasureGoodput(userPos, {RelayAt(userPos, fraction, altitude)});
+          if (goodput > oneRelay)
+            {
+              oneRelay = goodput;
+              bestFraction = fraction;
+              bestAltitude = altitude;
+            }
+        }
+    }
+
+  double twoRelays = g_config.heatmapRelays >= 2 ? MeasureGoodput(userPos, EvenlySpacedRelays(userPos, 2)) : 0.0;
+  return {direct, oneRelay, bestFraction, twoRelays, bestAltitude};
+}
+
+// Search the single-relay position (fraction of the way to the user and
+// altitude) that maximises goodput for a user userDistance metres from the AP
+void RunPlacement()
+{
+  Vector userPos(g_config.userDistance, 0.0, 0.0);
+  std::vector<double> altitudes = PlacementAltitudes();
+  uint32_t steps = g_config.placementSteps;
+
+  std::vector<std::vector<double>> results = RunParallel(1 + altitudes.size() * steps, [&](uint32_t job) {
+    if (job == 0)
+      return std::vector<double>{MeasureGoodput(userPos, {})};
+    double altitude = altitudes[(job - 1) / steps];
+    double fraction = (double)((job - 1) % steps + 1) / (steps + 1);
+    return std::vector<double>{MeasureGoodput(userPos, {RelayAt(userPos, fraction, altitude)})};
+  });
+
+  std::cout << "User at " << g_config.userDistance << " m, direct: " << results[0][0] << " Mbps" << std::endl;
+  uint32_t best = 1;
+  for (uint32_t job = 1; job < results.size(); job++)
+    {
+      double altitude = altitudes[(job - 1) / steps];
+      double fraction = (double)((job - 1) % steps + 1) / (steps + 1);
+      double hop = std::hypot(userPos.x * fraction, altitude);
+      std::cout << "  altitude=" << altitude << "m fraction=" << fraction << " (AP hop " << hop
+                << " m): " << results[job][0] << " Mbps" << std::endl;
+      if (results[job][0] > results[best][0])
+        best = job;
+    }
+  double bestAltitude = altitudes[(best - 1) / steps];
+  double bestFraction = (double)((best - 1) % steps + 1) / (steps + 1);
+  std::cout << "Best relay: altitude " << bestAltitude << " m, " << bestFraction << " of the way to the user, "
+            << results[best][0] << " Mbps (relay gain " << RelayGain(results[0][0], results[best][0]) << "%)"
+            << std::endl;
+
+  // Compare with the slower of the two hops used on its own, i.e. what a
+  // relay could carry if its hops did not share airtime
+  Vector relayPos = RelayAt(userPos, bestFraction, bestAltitude);
+  std::vector<Vector> hopEnds = {Vector(std::hypot(userPos.x - relayPos.x, userPos.y - relayPos.y), 0.0, relayPos.z),
+                                 Vector(std::hypot(relayPos.x, relayPos.y), 0.0, relayPos.z)};
+  std::vector<std::vector<double>> hops =
+      RunParallel(hopEnds.size(), [&](uint32_t job) { return std::vector<double>{MeasureGoodput(hopEnds[job], {})}; });
+  double bottleneck = std::min(hops[0][0], hops[1][0]);
+  std::cout << "Bottleneck hop alone: " << bottleneck << " Mbps; the relay reaches "
+            << (bottleneck > 0 ? 100.0 * results[best][0] / bottleneck : 0.0) << "% of it with "
+            << g_config.relayRadios << " radio(s) per drone" << std::endl;
+}
+
+// Scaling of a relay chain: goodput and per-hop airtime for 0 .. relays
+// evenly spaced relays between the AP and a user userDistance metres away.
+// On a single channel the hops share the airtime and goodput falls roughly
+// as 1/N; channel assignment lets distant hops transmit at the same time.
+void RunChain()
+{
+  Vector userPos(g_config.userDistance, 0.0, 0.0);
+  std::vector<std::vector<double>> results = RunParallel(g_config.relays + 1, [&](uint32_t nRelays) {
+    // {goodput, hops, (airtime, channel) per hop, (channel, busiest PHY busy share) per channel}
+    std::vector<HopReport> hops;
+    std::vector<double> values(1, MeasureGoodput(userPos, EvenlySpacedRelays(userPos, nRelays), &hops));
+    values.push_back(hops.size());
+    for (const HopReport &hop : hops)
+      {
+        values.push_back(hop.airtime);
+        values.push_back(hop.channel);
+      }
+    for (const auto &channel : g_channelUtilization)
+      {
+        values.push_back(channel.first);
+        values.push_back(channel.second.second);
+      }
+    return values;
+  });
+
+  std::cout << "Chain to a user at " << g_config.userDistance << " m, " << g_config.relayRadios
+            << " radio(s) per drone, " << g_config.channelAssignment << " channel assignment" << std::endl;
+  for (uint32_t nRelays = 0; nRelays <= g_config.relays; nRelays++)
+    {
+      const std::vector<double> &r = results[nRelays];
+      std::cout << "  " << nRelays << " relay(s): " << r[0] << " Mbps";
+      uint32_t nHops = r[1];
+      std::map<uint16_t, double> channelAirtime;
+      for (uint32_t h = 0; h < nHops; h++)
+        {
+          uint16_t channel = r[3 + 2 * h];
+          channelAirtime[channel] += r[2 + 2 * h];
+          std::cout << (h == 0 ? "; hop airtime " : ", ") << "hop" << h << "="
+                    << 100.0 * r[2 + 2 * h] << "% (ch " << (channel ? std::to_string(channel) : "primary") << ")";
+        }
+      double busiest = 0.0;
+      for (const auto &entry : channelAirtime)
+        busiest = std::max(busiest, entry.second);
+      if (!channelAirtime.empty())
+        std::cout << "; busiest channel " << 100.0 * busiest << "%";
+      for (size_t i = 2 + 2 * nHops; i + 1 < r.size(); i += 2)
+        std::cout << (i == 2 + 2 * nHops ? "; PHY busy " : ", ") << "ch " << r[i] << " " << 100.0 * r[i + 1] << "%";
+      std::cout << std::endl;
+    }
+}
+
+// Goodput map of a square grid centred on the AP. Cells are spread over the
+// probe processes; results go to <heatmapFile>.csv and to <heatmapFile>.bin,
+// a raster of float32 layers (direct, one relay, best relay fraction, two
+// relays, best relay altitude) in row-major order after a header of
+// {uint32 nx, uint32 ny, uint32 layers, float64 x0, float64 y0, float64 step}.
+void RunHeatmap()
+{
+  double step = g_config.gridStep;
+  uint32_t n = 2 * (uint32_t)std::floor(g_config.gridRadius / step) + 1;
+  double origin = -step * (n - 1) / 2;
+  auto cellPosition = [&](uint32_t cell) {
+    return Vector(origin + step * (cell % n), origin + step * (cell / n), 0.0);
+  };
+
+  std::cout << "Heatmap of " << n << "x" << n << " cells, " << step << " m apart" << std::endl;
+  std::vector<std::vector<double>> results =
+      RunParallel(n * n, [&](uint32_t cell) { return EvaluateCell(cellPosition(cell)); });
+
+  std::ofstream csv(g_config.heatmapFile + ".csv");
+  csv << "x,y,direct_mbps,one_relay_mbps,relay_fraction,two_relays_mbps,relay_altitude\n";
+  for (uint32_t cell = 0; cell < n * n; cell++)
+    {
+      Vector pos = cellPosition(cell);
+      const std::vector<double> &r = results[cell];
+      csv << pos.x << "," << pos.y << "," << r[0] << "," << r[1] << "," << r[2] << "," << r[3] << "," << r[4] << "\n";
+    }
+
+  const uint32_t layers = 5;
+  std::ofstream raster(g_config.heatmapFile + ".bin", std::ios::binary);
+  raster.write(reinterpret_cast<const char *>(&n), sizeof(n));
+  raster.write(reinterpret_cast<const char *>(&n), sizeof(n));
+  raster.write(reinterpret_cast<const char *>(&layers), sizeof(layers));
+  raster.write(reinterpret_cast<const char *>(&origin), sizeof(origin));
+  raster.write(reinterpret_cast<const char *>(&origin), sizeof(origin));
+  raster.write(reinterpret_cast<const char *>(&step), sizeof(step));
+  for (uint32_t layer = 0; layer < layers; layer++)
+    {
+      for (uint32_t cell = 0; cell < n * n; cell++)
+        {
+          float value = results[cell][layer];
+          raster.write(reinterpret_cast<const char *>(&value), sizeof(value));
+        }
+    }
+
+  uint32_t helped = 0;
+  for (uint32_t cell = 0; cell < n * n; cell++)
+    {
+      if (std::max(results[cell][1], results[cell][3]) > results[cell][0])
+        helped++;
+    }
+  std::cout << "Relaying improves goodput in " << helped << " of " << n * n << " cells; wrote "
+            << g_config.heatmapFile << ".csv and " << g_config.heatmapFile << ".bin" << std::endl;
+}
+
+// Aggregate goodput of `cells` relayed cells side by side on one channel,
+// cellSpacing metres apart: in each, a saturating flow from a user at
+// userDistance through a relay halfway to its AP. Returns {aggregate
+// goodput, goodput of every cell, mean TX power (dBm) of every cell's AP and
+// relay}.
+std::vector<double> MeasureCells(bool powerControl)
+{
+  Ptr<YansWifiChannel> channel = CreateChannel();
+  std::vector<Topology> cells(g_config.cells);
+  std::vector<Ptr<PacketSink>> sinks;
+  uint16_t port = 9;
+  Time stop = g_config.probeWarmup + g_config.probeTime;
+  for (uint32_t c = 0; c < cells.size(); c++)
+    {
+      Topology &topo = cells[c];
+      topo.channel = channel;
+      topo.subnet = c + 1;
+      topo.ap.Create(1);
+      topo.user.Create(1);
+      topo.relays.Create(1);
+      BuildNetwork(topo, true);
+      InstallRelayRoutes(topo);
+
+      Vector offset(0.0, c * g_config.cellSpacing, 0.0);
+      Vector userPos(g_config.userDistance, 0.0, 0.0);
+      Vector relayPos = RelayAt(userPos, 0.5, g_config.droneAltitude);
+      topo.ap.Get(0)->GetObject<MobilityModel>()->SetPosition(offset);
+      topo.user.Get(0)->GetObject<MobilityModel>()->SetPosition(userPos + offset);
+      topo.relays.Get(0)->GetObject<MobilityModel>()->SetPosition(relayPos + offset);
+      if (powerControl)
+        ApplyPowerControl(topo);
+
+      PacketSinkHelper sinkHelper("ns3::UdpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), port));
+      ApplicationContainer sinkApps = sinkHelper.Install(topo.ap.Get(0));
+      sinkApps.Stop(stop);
+      sinks.push_back(DynamicCast<PacketSink>(sinkApps.Get(0)));
+
+      OnOffHelper source("ns3::UdpSocketFactory", InetSocketAddress(topo.ApAddress(), port));
+      source.SetConstantRate(DataRate(g_config.probeRate), 1024);
+      ApplicationContainer sourceApps = source.Install(topo.user.Get(0));
+      sourceApps.Start(Seconds(0.1));
+      sourceApps.Stop(stop);
+    }
+
+  std::vector<uint64_t> warmupBytes(cells.size());
+  Simulator::Schedule(g_config.probeWarmup, [&]() {
+    for (uint32_t c = 0; c < cells.size(); c++)
+      warmupBytes[c] = sinks[c]->GetTotalRx();
+  });
+
+  Simulator::Stop(stop);
+  Simulator::Run();
+  std::vector<double> result(1, 0.0);
+  for (uint32_t c = 0; c < cells.size(); c++)
+    {
+      double goodput = (sinks[c]->GetTotalRx() - warmupBytes[c]) * 8.0 / g_config.probeTime.GetSeconds() / 1e6;
+      result[0] += goodput;
+      result.push_back(goodput);
+    }
+  for (const Topology &topo : cells)
+    result.push_back((FirstWifiPhy(topo.ap.Get(0))->GetTxPowerStart() +
+                      FirstWifiPhy(topo.relays.Get(0))->GetTxPowerStart()) / 2.0);
+  Simulator::Destroy();
+  return result;
+}
+
+// Multi-cell goodput at default TX power and with link-budget power control
+void RunCells()
+{
+  NS_ABORT_MSG_IF(g_config.forwarding != "routed" || g_config.routing != "static",
+                  "Cells mode needs static routed forwarding");
+  NS_ABORT_MSG_IF(g_config.cells < 1, "Cells mode needs at least one cell");
+  std::vector<std::vector<double>> results =
+      RunParallel(2, [](uint32_t job) { return MeasureCells(job == 1); });
+
+  uint32_t n = g_config.cells;
+  std::cout << n << " cells " << g_config.cellSpacing << " m apart on one channel, user at "
+            << g_config.userDistance << " m, power control targets MCS " << g_config.powerTargetMcs << " + "
+            << g_config.powerMargin << " dB" << std::endl;
+  for (uint32_t job = 0; job < 2; job++)
+    {
+      const std::vector<double> &r = results[job];
+      std::cout << "  " << (job ? "power control" : "default power") << ": " << r[0] << " Mbps total";
+      for (uint32_t c = 0; c < n; c++)
+        std::cout << (c ? ", " : " (") << "cell " << c << " " << r[1 + c] << " Mbps at " << r[1 + n + c] << " dBm";
+      std::cout << ")" << std::endl;
+    }
+  std::cout << "Power control changes aggregate goodput by " << RelayGain(results[0][0], results[1][0]) << "%"
+            << std::endl;
+}
+
+// ---------------------------------------------------------------------------
+// Two-way relay network coding
+//
+// The echo workload under load: the user and the AP exchange constant-rate
+// UDP flows through one relay, which forwards them at the application layer.
+// Plain store-and-forward sends every packet on. With coding, the relay holds
+// a packet up to codingHold for one in the opposite direction and sends the
+// XOR of both as a single frame, unicast to one endpoint while the other
+// overhears it (COPE-style pseudo-broadcast, so the frame keeps the unicast
+// rate and retries). Each endpoint decodes with its own packet.
+// ---------------------------------------------------------------------------
+
+const uint16_t CODING_PORT = 9100;
+
+class CodingHeader : public Header
+{
+public:
+  enum Type : uint8_t
+  {
+    NATIVE = 0,
+    CODED = 1
+  };
+
+  static TypeId GetTypeId()
+  {
+    static TypeId tid = TypeId("ns3::CodingHeader").SetParent<Header>().AddConstructor<CodingHeader>();
+    return tid;
+  }
+
+  TypeId GetInstanceTypeId() const override { return GetTypeId(); }
+
+  uint32_t GetSerializedSize() const override { return 12; }
+
+  void Serialize(Buffer::Iterator start) const override
+  {
+    start.WriteU8(type);
+    start.WriteU8(direction);
+    start.WriteHtonU32(seqUp);
+    start.WriteHtonU32(seqDown);
+    start.WriteHtonU16(length);
+  }
+
+  uint32_t Deserialize(Buffer::Iterator start) override
+  {
+    type = start.ReadU8();
+    direction = start.ReadU8();
+    seqUp = start.ReadNtohU32();
+    seqDown = start.ReadNtohU32();
+    length = start.ReadNtohU16();
+    return GetSerializedSize();
+  }
+
+  void Print(std::ostream &os) const override
+  {
+    os << (type == CODED ? "coded" : "native") << " up=" << seqUp << " down=" << seqDown << " len=" << length;
+  }
+
+  uint8_t type = NATIVE;
+  uint8_t direction = 0; // native packets: 0 user->AP, 1 AP->user
+  uint32_t seqUp = 0;    // user->AP packet carried (native up, or coded)
+  uint32_t seqDown = 0;  // AP->user packet carried (native down, or coded)
+  uint16_t length = 0;   // payload bytes
+};
+
+NS_OBJECT_ENSURE_REGISTERED(CodingHeader);
+
+// Payload of packet `seq` in `direction`. Endpoints regenerate their own
+// packets from it for decoding, standing in for the copies a real endpoint
+// keeps, and check decoded payloads against it.
+std::vector<uint8_t> CodingPayload(uint8_t direction, uint32_t seq, uint16_t length)
+{
+  std::vector<uint8_t> payload(length);
+  for (uint16_t i = 0; i < length; i++)
+    payload[i] = (seq * 31 + i + direction * 101) & 0xff;
+  return payload;
+}
+
+// UDP payload (still followed by the FCS) of a sniffed data frame carrying a
+// datagram to `port`, with its MAC header in `hdr`; null for any other frame
+Ptr<Packet> PeekUdpDatagram(Ptr<const Packet> p, uint16_t port, WifiMacHeader &hdr)
+{
+  Ptr<Packet> copy = p->Copy();
+  AmpduSubframeHeader subframe;
+  copy->PeekHeader(subframe);
+  if (subframe.IsSignatureValid())
+    copy->RemoveHeader(subframe);
+  copy->RemoveHeader(hdr);
+  if (!hdr.IsData())
+    return nullptr;
+
+  LlcSnapHeader llc;
+  Ipv4Header ip;
+  UdpHeader udp;
+  copy->RemoveHeader(llc);
+  if (llc.GetType() != Ipv4L3Protocol::PROT_NUMBER)
+    return nullptr;
+  copy->RemoveHeader(ip);
+  if (ip.GetProtocol() != UdpL4Protocol::PROT_NUMBER)
+    return nullptr;
+  copy->RemoveHeader(udp);
+  return udp.GetDestinationPort() == port ? copy : nullptr;
+}
+
+// Coding header and payload of a sniffed frame carrying a UDP datagram to
+// the coding port; false for any other frame
+bool PeekCodingFrame(Ptr<const Packet> p, WifiMacHeader &hdr, CodingHeader &coding, std::vector<uint8_t> &payload)
+{
+  Ptr<Packet> copy = PeekUdpDatagram(p, CODING_PORT, hdr);
+  if (!copy)
+    return false;
+  copy->RemoveHeader(coding);
+  // The sniffed MPDU still ends with its FCS
+  payload.resize(std::min<uint32_t>(coding.length, copy->GetSize()));
+  copy->CopyData(payload.data(), payload.size());
+  return true;
+}
+
+// User or AP side: sends one flow to the relay and receives the other,
+// natively or by decoding coded frames it is sent or overhears
+class CodingEndpoint : public Application
+{
+public:
+  static TypeId GetTypeId()
+  {
+    static TypeId tid = TypeId("ns3::CodingEndpoint").SetParent<Application>().AddConstructor<CodingEndpoint>();
+    return tid;
+  }
+
+  void Setup(uint8_t direction, Mac48Address address, Ipv4Address relay, DataRate rate, uint16_t size)
+  {
+    m_direction = direction;
+    m_address = address;
+    m_relay = relay;
+    m_rate = rate;
+    m_size = size;
+  }
+
+  // Start counting deliveries afresh (end of the warm-up)
+  void ResetCounters()
+  {
+    m_bytes = 0;
+    m_decoded = 0;
+    m_decodeFailures = 0;
+  }
+
+  uint64_t GetReceivedBytes() const { return m_bytes; }
+  uint64_t GetDecoded() const { return m_decoded; }
+  uint64_t GetDecodeFailures() const { return m_decodeFailures; }
+
+  // MonitorSnifferRx of the endpoint's PHY: take coded frames the relay
+  // addressed to the other endpoint
+  void Overhear(Ptr<const Packet> p, uint16_t channelFreqMhz, WifiTxVector txVector, MpduInfo aMpdu,
+                SignalNoiseDbm signalNoise, uint16_t staId)
+  {
+    WifiMacHeader hdr;
+    CodingHeader coding;
+    std::vector<uint8_t> payload;
+    if (!PeekCodingFrame(p, hdr, coding, payload) || coding.type != CodingHeader::CODED ||
+        hdr.GetAddr1() == m_address)
+      return;
+    Decode(coding, payload);
+  }
+
+private:
+  void StartApplication() override
+  {
+    m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+    m_socket->Bind(InetSocketAddress(Ipv4Address::GetAny(), CODING_PORT));
+    m_socket->SetRecvCallback(MakeCallback(&CodingEndpoint::Receive, this));
+    m_sendEvent = Simulator::ScheduleNow(&CodingEndpoint::Send, this);
+  }
+
+  void StopApplication() override
+  {
+    m_sendEvent.Cancel();
+    m_socket->Close();
+  }
+
+  void Send()
+  {
+    std::vector<uint8_t> payload = CodingPayload(m_direction, m_seq, m_size);
+    Ptr<Packet> p = Create<Packet>(payload.data(), payload.size());
+    CodingHeader coding;
+    coding.direction = m_direction;
+    (m_direction == 0 ? coding.seqUp : coding.seqDown) = m_seq++;
+    coding.length = m_size;
+    p->AddHeader(coding);
+    m_socket->SendTo(p, 0, InetSocketAddress(m_relay, CODING_PORT));
+    m_sendEvent = Simulator::Schedule(m_rate.CalculateBytesTxTime(m_size), &CodingEndpoint::Send, this);
+  }
+
+  void Receive(Ptr<Socket> socket)
+  {
+    Ptr<Packet> p;
+    while ((p = socket->Recv()))
+      {
+        CodingHeader coding;
+        p->RemoveHeader(coding);
+        std::vector<uint8_t> payload(p->GetSize());
+        p->CopyData(payload.data(), payload.size());
+        if (coding.type == CodingHeader::CODED)
+          Decode(coding, payload);
+        else if (coding.direction != m_direction)
+          Deliver(coding.direction == 0 ? coding.seqUp : coding.seqDown, payload.size());
+      }
+  }
+
+  // XOR out our own packet and check what is left is the expected one
+  void Decode(const CodingHeader &coding, std::vector<uint8_t> &payload)
+  {
+    uint32_t own = m_direction == 0 ? coding.seqUp : coding.seqDown;
+    uint32_t other = m_direction == 0 ? coding.seqDown : coding.seqUp;
+    std::vector<uint8_t> mine = CodingPayload(m_direction, own, coding.length);
+    for (size_t i = 0; i < payload.size(); i++)
+      payload[i] ^= mine[i];
+    if (payload != CodingPayload(1 - m_direction, other, payload.size()))
+      {
+        m_decodeFailures++;
+        return;
+      }
+    if (Deliver(other, payload.size()))
+      m_decoded++;
+  }
+
+  // Count a packet of the other flow once, however often it arrives
+  bool Deliver(uint32_t seq, uint32_t bytes)
+  {
+    if (!m_received.insert(seq).second)
+      return false;
+    m_bytes += bytes;
+    return true;
+  }
+
+  uint8_t m_direction = 0;
+  Mac48Address m_address;
+  Ipv4Address m_relay;
+  DataRate m_rate;
+  uint16_t m_size = 1000;
+  uint32_t m_seq = 0;
+  Ptr<Socket> m_socket;
+  EventId m_sendEvent;
+  std::set<uint32_t> m_received;
+  uint64_t m_bytes = 0;
+  uint64_t m_decoded = 0;
+  uint64_t m_decodeFailures = 0;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(CodingEndpoint);
+
+// Relay side: forwards each flow to the other endpoint, coding opposite
+// packets together when enabled
+class CodingRelay : public Application
+{
+public:
+  static TypeId GetTypeId()
+  {
+    static TypeId tid = TypeId("ns3::CodingRelay").SetParent<Application>().AddConstructor<CodingRelay>();
+    return tid;
+  }
+
+  void Setup(Ipv4Address user, Ipv4Address ap, bool coding, Time hold)
+  {
+    m_endpoints[0] = user;
+    m_endpoints[1] = ap;
+    m_coding = coding;
+    m_hold = hold;
+  }
+
+  void ResetCounters()
+  {
+    m_native = 0;
+    m_coded = 0;
+  }
+
+  uint64_t GetNativeSent() const { return m_native; }
+  uint64_t GetCodedSent() const { return m_coded; }
+
+private:
+  struct Pending
+  {
+    CodingHeader coding;
+    std::vector<uint8_t> payload;
+    Time arrival;
+  };
+
+  void StartApplication() override
+  {
+    m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+    m_socket->Bind(InetSocketAddress(Ipv4Address::GetAny(), CODING_PORT));
+    m_socket->SetRecvCallback(MakeCallback(&CodingRelay::Receive, this));
+  }
+
+  void StopApplication() override { m_socket->Close(); }
+
+  void Receive(Ptr<Socket> socket)
+  {
+    Ptr<Packet> p;
+    while ((p = socket->Recv()))
+      {
+        Pending pending;
+        p->RemoveHeader(pending.coding);
+        pending.payload.resize(p->GetSize());
+        p->CopyData(pending.payload.data(), pending.payload.size());
+        pending.arrival = Simulator::Now();
+
+        uint8_t direction = pending.coding.direction;
+        std::deque<Pending> &opposite = m_queues[1 - direction];
+        if (!m_coding)
+          SendNative(pending);
+        else if (!opposite.empty())
+          {
+            SendCoded(pending, opposite.front());
+            opposite.pop_front();
+          }
+        else
+          {
+            // Bounded wait: anything not coded after m_hold goes out natively
+            if (m_queues[direction].size() >= 1000)
+              m_queues[direction].pop_front();
+            m_queues[direction].push_back(pending);
+            Simulator::Schedule(m_hold, &CodingRelay::Flush, this);
+          }
+      }
+  }
+
+  void Flush()
+  {
+    for (std::deque<Pending> &queue : m_queues)
+      while (!queue.empty() && Simulator::Now() - queue.front().arrival >= m_hold)
+        {
+          SendNative(queue.front());
+          queue.pop_front();
+        }
+  }
+
+  void SendNative(const Pending &pending)
+  {
+    Ptr<Packet> p = Create<Packet>(pending.payload.data(), pending.payload.size());
+    p->AddHeader(pending.coding);
+    m_socket->SendTo(p, 0, InetSocketAddress(m_endpoints[1 - pending.coding.direction], CODING_PORT));
+    m_native++;
+  }
+
+  void SendCoded(const Pending &a, const Pending &b)
+  {
+    const Pending &up = a.coding.direction == 0 ? a : b;
+    const Pending &down = a.coding.direction == 0 ? b : a;
+    std::vector<uint8_t> payload(std::max(up.payload.size(), down.payload.size()), 0);
+    for (size_t i = 0; i < payload.size(); i++)
+      payload[i] = (i < up.payload.size() ? up.payload[i] : 0) ^ (i < down.payload.size() ? down.payload[i] : 0);
+
+    CodingHeader coding;
+    coding.type = CodingHeader::CODED;
+    coding.seqUp = up.coding.seqUp;
+    coding.seqDown = down.coding.seqDown;
+    coding.length = payload.size();
+    Ptr<Packet> p = Create<Packet>(payload.data(), payload.size());
+    p->AddHeader(coding);
+    // Alternate the addressed endpoint; the other one overhears
+    m_socket->SendTo(p, 0, InetSocketAddress(m_endpoints[m_coded % 2], CODING_PORT));
+    m_coded++;
+  }
+
+  Ipv4Address m_endpoints[2]; // user, AP
+  bool m_coding = false;
+  Time m_hold;
+  Ptr<Socket> m_socket;
+  std::deque<Pending> m_queues[2]; // waiting for a partner, by direction
+  uint64_t m_native = 0;
+  uint64_t m_coded = 0;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(CodingRelay);
+
+// Two-way exchange of probeRate flows through one relay halfway to a user
+// at userDistance, with or without coding. Returns {user->AP Mbit/s,
+// AP->user Mbit/s, relay TX airtime share, channel TX airtime share, coded
+// share of the relay's frames, decode failures}.
+std::vector<double> MeasureCoding(bool coding)
+{
+  Topology topo;
+  topo.ap.Create(1);
+  topo.user.Create(1);
+  topo.relays.Create(1);
+  BuildNetwork(topo, true);
+
+  Vector userPos(g_config.userDistance, 0.0, 0.0);
+  topo.ap.Get(0)->GetObject<MobilityModel>()->SetPosition(Vector(0.0, 0.0, 0.0));
+  topo.user.Get(0)->GetObject<MobilityModel>()->SetPosition(userPos);
+  topo.relays.Get(0)->GetObject<MobilityModel>()->SetPosition(RelayAt(userPos, 0.5, g_config.droneAltitude));
+  EnablePhyStateTracing(topo);
+
+  Ptr<CodingRelay> relay = CreateObject<CodingRelay>();
+  relay->Setup(topo.UserAddress(), topo.ApAddress(), coding, g_config.codingHold);
+  topo.relays.Get(0)->AddApplication(relay);
+  Ipv4Address relayAddress = GetDeviceAddress(topo.devices.Get(2)).first;
+
+  std::vector<Ptr<CodingEndpoint>> endpoints;
+  NodeContainer ends(topo.user, topo.ap);
+  for (uint8_t direction = 0; direction < 2; direction++)
+    {
+      Ptr<CodingEndpoint> endpoint = CreateObject<CodingEndpoint>();
+      endpoint->Setup(direction, Mac48Address::ConvertFrom(topo.devices.Get(direction)->GetAddress()), relayAddress,
+                      DataRate(g_config.probeRate), 1000);
+      endpoint->SetStartTime(Seconds(0.1));
+      ends.Get(direction)->AddApplication(endpoint);
+      FirstWifiPhy(ends.Get(direction))
+          ->TraceConnectWithoutContext("MonitorSnifferRx", MakeCallback(&CodingEndpoint::Overhear, endpoint));
+      endpoints.push_back(endpoint);
+    }
+
+  Simulator::Schedule(g_config.probeWarmup, [&]() {
+    for (Ptr<CodingEndpoint> endpoint : endpoints)
+      endpoint->ResetCounters();
+    relay->ResetCounters();
+    ResetPhyStates();
+  });
+
+  Time stop = g_config.probeWarmup + g_config.probeTime;
+  Simulator::Stop(stop);
+  Simulator::Run();
+
+  double seconds = g_config.probeTime.GetSeconds();
+  double relayTx = 0.0;
+  for (const auto &entry : g_phyStates)
+    if (entry.first.first == topo.relays.Get(0)->GetId())
+      relayTx += entry.second.tx.GetSeconds() / seconds;
+  double channelTx = 0.0;
+  for (const auto &entry : ChannelUtilization())
+    channelTx += entry.second.first;
+  uint64_t relayFrames = relay->GetNativeSent() + relay->GetCodedSent();
+  std::vector<double> result = {endpoints[1]->GetReceivedBytes() * 8.0 / seconds / 1e6,
+                                endpoints[0]->GetReceivedBytes() * 8.0 / seconds / 1e6,
+                                relayTx,
+                                channelTx,
+                                relayFrames ? (double)relay->GetCodedSent() / relayFrames : 0.0,
+                                (double)(endpoints[0]->GetDecodeFailures() + endpoints[1]->GetDecodeFailures())};
+  Simulator::Destroy();
+  return result;
+}
+
+// Compare plain store-and-forward with XOR coding at the relay
+void RunCoding()
+{
+  // Overhearing needs all three nodes on one routed channel
+  NS_ABORT_MSG_IF(g_config.forwarding != "routed" || g_config.relayRadios != 1,
+                  "Coding mode needs routed forwarding and single-radio relays");
+  std::vector<std::vector<double>> results =
+      RunParallel(2, [](uint32_t job) { return MeasureCoding(job == 1); });
+
+  std::cout << "Two-way relay, user at " << g_config.userDistance << " m, " << g_config.probeRate
+            << " offered each way" << std::endl;
+  for (uint32_t job = 0; job < 2; job++)
+    {
+      const std::vector<double> &r = results[job];
+      std::cout << "  " << (job ? "coded" : "plain") << ": up " << r[0] << " Mbps, down " << r[1]
+                << " Mbps; relay TX airtime " << 100.0 * r[2] << "%, channel TX airtime " << 100.0 * r[3] << "%";
+      if (job)
+        std::cout << "; " << 100.0 * r[4] << "% of relay frames coded, " << r[5] << " decode failures";
+      std::cout << std::endl;
+    }
+  // Relay airtime spent per delivered Mbit/s
+  double plain = results[0][2] / std::max(1e-9, results[0][0] + results[0][1]);
+  double coded = results[1][2] / std::max(1e-9, results[1][0] + results[1][1]);
+  std::cout << "Coding changes goodput by " << RelayGain(results[0][0] + results[0][1], results[1][0] + results[1][1])
+            << "% and relay airtime per delivered bit by " << (plain > 0 ? 100.0 * (coded - plain) / plain : 0.0)
+            << "%" << std::endl;
+}
+
+// ---------------------------------------------------------------------------
+// Multipath duplication
+//
+// The transition while the first drone flies out: the direct link is marginal
+// and the relay is not yet where it should be. The user sends each packet
+// straight to the AP, through the relay (an application-level forwarder) or
+// both ways. The AP keeps the first copy of each sequence number, using a
+// sliding window of recently seen ones.
+// ---------------------------------------------------------------------------
+
+const uint16_t DUPLICATION_PORT = 9200;
+
+// Constant-rate UDP source sending every packet to each of its targets
+class DuplicationSource : public Application
+{
+public:
+  static TypeId GetTypeId()
+  {
+    static TypeId tid =
+        TypeId("ns3::DuplicationSource").SetParent<Application>().AddConstructor<DuplicationSource>();
+    return tid;
+  }
+
+  void Setup(const std::vector<Ipv4Address> &targets, DataRate rate, uint16_t size)
+  {
+    m_targets = targets;
+    m_rate = rate;
+    m_size = size;
+  }
+
+  void ResetCounters() { m_sent = 0; }
+
+  uint64_t GetSent() const { return m_sent; }
+
+private:
+  void StartApplication() override
+  {
+    m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+    m_socket->Bind();
+    m_sendEvent = Simulator::ScheduleNow(&DuplicationSource::Send, this);
+  }
+
+  void StopApplication() override
+  {
+    m_sendEvent.Cancel();
+    m_socket->Close();
+  }
+
+  void Send()
+  {
+    SeqTsHeader seqTs;
+    seqTs.SetSeq(m_seq++);
+    for (const Ipv4Address &target : m_targets)
+      {
+        Ptr<Packet> p = Create<Packet>(m_size - seqTs.GetSerializedSize());
+        p->AddHeader(seqTs);
+        m_socket->SendTo(p, 0, InetSocketAddress(target, DUPLICATION_PORT));
+      }
+    m_sent++;
+    m_sendEvent = Simulator::Schedule(m_rate.CalculateBytesTxTime(m_size), &DuplicationSource::Send, this);
+  }
+
+  std::vector<Ipv4Address> m_targets;
+  DataRate m_rate;
+  uint16_t m_size = 1000;
+  uint32_t m_seq = 0;
+  uint64_t m_sent = 0;
+  Ptr<Socket> m_socket;
+  EventId m_sendEvent;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(DuplicationSource);
+
+// Relay side: passes every datagram on to one address unchanged
+class UdpForwarder : public Application
+{
+public:
+  static TypeId GetTypeId()
+  {
+    static TypeId tid = TypeId("ns3::UdpForwarder").SetParent<Application>().AddConstructor<UdpForwarder>();
+    return tid;
+  }
+
+  void Setup(Ipv4Address to) { m_to = to; }
+
+private:
+  void StartApplication() override
+  {
+    m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+    m_socket->Bind(InetSocketAddress(Ipv4Address::GetAny(), DUPLICATION_PORT));
+    m_socket->SetRecvCallback(MakeCallback(&UdpForwarder::Receive, this));
+  }
+
+  void StopApplication() override { m_socket->Close(); }
+
+  void Receive(Ptr<Socket> socket)
+  {
+    Ptr<Packet> p;
+    while ((p = socket->Recv()))
+      m_socket->SendTo(p, 0, InetSocketAddress(m_to, DUPLICATION_PORT));
+  }
+
+  Ipv4Address m_to;
+  Ptr<Socket> m_socket;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(UdpForwarder);
+
+// AP side: delivers the first copy of each sequence number. The window
+// remembers the last `window` sequence numbers; anything older is dropped as
+// a duplicate without being looked up.
+class DuplicationSink : public Application
+{
+public:
+  static TypeId GetTypeId()
+  {
+    static TypeId tid = TypeId("ns3::DuplicationSink").SetParent<Application>().AddConstructor<DuplicationSink>();
+    return tid;
+  }
+
+  void Setup(uint32_t window) { m_seen.assign(std::max(1u, window), false); }
+
+  // Count only packets sent from `from` on
+  void ResetCounters(Time from)
+  {
+    m_from = from;
+    m_delivered = 0;
+    m_duplicates = 0;
+    m_latencies.clear();
+  }
+
+  uint64_t GetDelivered() const { return m_delivered; }
+  uint64_t GetDuplicates() const { return m_duplicates; }
+  const std::vector<double> &GetLatencies() const { return m_latencies; }
+
+private:
+  void StartApplication() override
+  {
+    m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+    m_socket->Bind(InetSocketAddress(Ipv4Address::GetAny(), DUPLICATION_PORT));
+    m_socket->SetRecvCallback(MakeCallback(&DuplicationSink::Receive, this));
+  }
+
+  void StopApplication() override { m_socket->Close(); }
+
+  void Receive(Ptr<Socket> socket)
+  {
+    Ptr<Packet> p;
+    while ((p = socket->Recv()))
+      {
+        SeqTsHeader seqTs;
+        p->RemoveHeader(seqTs);
+        bool first = Accept(seqTs.GetSeq());
+        if (seqTs.GetTs() < m_from)
+          continue;
+        if (!first)
+          {
+            m_duplicates++;
+            continue;
+          }
+        m_delivered++;
+        m_latencies.push_back((Simulator::Now() - seqTs.GetTs()).GetSeconds());
+      }
+  }
+
+  // Mark `seq` as seen; false if it was already seen or fell out of the window
+  bool Accept(uint32_t seq)
+  {
+    uint32_t window = m_seen.size();
+    if (m_any && seq + window <= m_highest)
+      return false;
+    if (!m_any || seq > m_highest)
+      {
+        // Slide forward, forgetting the slots the new sequence numbers reuse
+        uint32_t start = m_any ? m_highest + 1 : seq;
+        for (uint32_t s = std::max(start, seq >= window ? seq - window + 1 : 0); s <= seq; s++)
+          m_seen[s % window] = false;
+        m_highest = seq;
+        m_any = true;
+      }
+    if (m_seen[seq % window])
+      return false;
+    m_seen[seq % window] = true;
+    return true;
+  }
+
+  std::vector<bool> m_seen = std::vector<bool>(1024, false);
+  uint32_t m_highest = 0;
+  bool m_any = false;
+  Time m_from;
+  Ptr<Socket> m_socket;
+  uint64_t m_delivered = 0;
+  uint64_t m_duplicates = 0;
+  std::vector<double> m_latencies; // s, first copies only
+};
 
-// Globals for tracking
-uint64_t g_txPackets = 0;
-uint64_t g_rxPackets = 0;
-Ptr<Node> g_user;
-Ptr<Node> g_ap;
+NS_OBJECT_ENSURE_REGISTERED(DuplicationSink);
 
-// Collect packet Tx/Rx stats
-void TxTrace(Ptr<const Packet> p) { g_txPackets++; }
-void RxTrace(Ptr<const Packet> p, const Address &) { g_rxPackets++; }
+// Send --duplicationRate from a user at userDistance to the AP over the
+// direct path (paths=1), through a relay `fraction` of the way out (2) or
+// both (3). Returns {loss ratio, median, p99 and max latency (ms), channel TX
+// airtime share, duplicate copies per delivered packet}.
+std::vector<double> MeasureDuplication(double fraction, uint32_t paths)
+{
+  Topology topo;
+  topo.ap.Create(1);
+  topo.user.Create(1);
+  topo.relays.Create(1);
+  BuildNetwork(topo, true);
+
+  Vector userPos(g_config.userDistance, 0.0, 0.0);
+  topo.ap.Get(0)->GetObject<MobilityModel>()->SetPosition(Vector(0.0, 0.0, 0.0));
+  topo.user.Get(0)->GetObject<MobilityModel>()->SetPosition(userPos);
+  topo.relays.Get(0)->GetObject<MobilityModel>()->SetPosition(RelayAt(userPos, fraction, g_config.droneAltitude));
+  EnablePhyStateTracing(topo);
+
+  std::vector<Ipv4Address> targets;
+  if (paths & 1)
+    targets.push_back(topo.ApAddress());
+  if (paths & 2)
+    targets.push_back(GetDeviceAddress(topo.devices.Get(2)).first);
+
+  Ptr<DuplicationSource> source = CreateObject<DuplicationSource>();
+  source->Setup(targets, DataRate(g_config.duplicationRate), 1000);
+  source->SetStartTime(Seconds(0.1));
+  Time end = g_config.probeWarmup + g_config.probeTime;
+  source->SetStopTime(end);
+  topo.user.Get(0)->AddApplication(source);
+
+  Ptr<UdpForwarder> forwarder = CreateObject<UdpForwarder>();
+  forwarder->Setup(topo.ApAddress());
+  topo.relays.Get(0)->AddApplication(forwarder);
+
+  Ptr<DuplicationSink> sink = CreateObject<DuplicationSink>();
+  sink->Setup(g_config.duplicationWindow);
+  topo.ap.Get(0)->AddApplication(sink);
+
+  Simulator::Schedule(g_config.probeWarmup, [&]() {
+    source->ResetCounters();
+    sink->ResetCounters(Simulator::Now());
+    ResetPhyStates();
+  });
+  double channelTx = 0.0;
+  Simulator::Schedule(end, [&]() {
+    for (const auto &entry : ChannelUtilization())
+      channelTx += entry.second.first;
+  });
+
+  // Leave time for the last packets to drain
+  Simulator::Stop(end + Seconds(0.5));
+  Simulator::Run();
+
+  std::vector<double> latencies = sink->GetLatencies();
+  std::sort(latencies.begin(), latencies.end());
+  auto percentile = [&](double q) {
+    return latencies.empty() ? -1.0 : 1000.0 * latencies[(size_t)std::round(q * (latencies.size() - 1))];
+  };
+  uint64_t sent = source->GetSent();
+  uint64_t delivered = std::min(sink->GetDelivered(), sent);
+  std::vector<double> result = {sent ? 1.0 - (double)delivered / sent : 0.0,
+                                percentile(0.5),
+                                percentile(0.99),
+                                percentile(1.0),
+                                channelTx,
+                                delivered ? (double)sink->GetDuplicates() / delivered : 0.0};
+  Simulator::Destroy();
+  return result;
+}
+
+// Compare direct, relayed and duplicated delivery with the relay at several
+// points of its way out
+void RunDuplication()
+{
+  // A routing protocol could send the direct copies through the relay too
+  NS_ABORT_MSG_IF(g_config.forwarding != "routed" || g_config.routing != "static" || g_config.relayRadios != 1,
+                  "Duplication mode needs static routed forwarding and single-radio relays");
+  const std::vector<double> fractions = {0.1, 0.2, 0.3, 0.4, 0.5};
+  const char *pathNames[] = {"direct", "relayed", "both"};
+  std::vector<std::vector<double>> results = RunParallel(fractions.size() * 3, [&](uint32_t job) {
+    return MeasureDuplication(fractions[job / 3], job % 3 + 1);
+  });
+
+  std::cout << "Multipath duplication, user at " << g_config.userDistance << " m, " << g_config.duplicationRate
+            << std::endl;
+  for (size_t f = 0; f < fractions.size(); f++)
+    {
+      std::cout << "Relay " << fractions[f] * g_config.userDistance << " m out:" << std::endl;
+      for (uint32_t path = 0; path < 3; path++)
+        {
+          const std::vector<double> &r = results[f * 3 + path];
+          std::cout << "  " << pathNames[path] << ": loss " << 100.0 * r[0] << "%, latency median " << r[1]
+                    << " ms p99 " << r[2] << " ms max " << r[3] << " ms, channel TX airtime " << 100.0 * r[4] << "%";
+          if (path == 2)
+            std::cout << ", " << r[5] << " duplicates per packet";
+          std::cout << std::endl;
+        }
+      // Against the better single path, by loss
+      const std::vector<double> &best = results[f * 3 + (results[f * 3][0] <= results[f * 3 + 1][0] ? 0 : 1)];
+      const std::vector<double> &both = results[f * 3 + 2];
+      std::cout << "  duplication vs best single path: loss " << 100.0 * (best[0] - both[0])
+                << " points lower, p99 " << best[2] - both[2] << " ms lower, airtime "
+                << 100.0 * (both[4] - best[4]) << " points higher" << std::endl;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Opportunistic forwarding
+//
+// ExOR-style forwarding along a relay chain at the application layer. Chain
+// nodes are numbered from the user (0) to the AP; a higher number means
+// closer to the AP and a higher forwarding priority. Every transmission is
+// unicast to the next node, which the MAC ACK makes reliable, and any node
+// further down the chain that overhears it also takes the packet. A relay
+// holds a packet for one exorSlot per higher-priority node (the AP
+// included) before sending it on, and drops it if it hears one of them
+// forward it first or the AP confirm it. The AP confirms what it delivered
+// in a broadcast batch map at most half a slot after the first delivery in
+// it. Strict forwarding runs the same applications without overhearing,
+// holding or confirmations.
+// ---------------------------------------------------------------------------
+
+const uint16_t EXOR_PORT = 9400;
+const uint16_t EXOR_ACK_PORT = 9401;
+
+class ExorHeader : public Header
+{
+public:
+  static TypeId GetTypeId()
+  {
+    static TypeId tid = TypeId("ns3::ExorHeader").SetParent<Header>().AddConstructor<ExorHeader>();
+    return tid;
+  }
+
+  TypeId GetInstanceTypeId() const override { return GetTypeId(); }
+
+  uint32_t GetSerializedSize() const override { return 14; }
+
+  void Serialize(Buffer::Iterator start) const override
+  {
+    start.WriteHtonU32(seq);
+    start.WriteU8(from);
+    start.WriteU8(hops);
+    start.WriteHtonU64(sent.GetTimeStep());
+  }
+
+  uint32_t Deserialize(Buffer::Iterator start) override
+  {
+    seq = start.ReadNtohU32();
+    from = start.ReadU8();
+    hops = start.ReadU8();
+    sent = TimeStep(start.ReadNtohU64());
+    return GetSerializedSize();
+  }
+
+  void Print(std::ostream &os) const override { os << "seq=" << seq << " from=" << (uint32_t)from; }
+
+  uint32_t seq = 0;
+  uint8_t from = 0; // chain index of the transmitter
+  uint8_t hops = 0; // transmissions so far
+  Time sent;        // by the user
+};
+
+NS_OBJECT_ENSURE_REGISTERED(ExorHeader);
+
+// Batch map the AP broadcasts: packets delivered since the last one
+class ExorAckHeader : public Header
+{
+public:
+  static TypeId GetTypeId()
+  {
+    static TypeId tid = TypeId("ns3::ExorAckHeader").SetParent<Header>().AddConstructor<ExorAckHeader>();
+    return tid;
+  }
+
+  TypeId GetInstanceTypeId() const override { return GetTypeId(); }
+
+  uint32_t GetSerializedSize() const override { return 2 + 4 * seqs.size(); }
+
+  void Serialize(Buffer::Iterator start) const override
+  {
+    start.WriteHtonU16(seqs.size());
+    for (uint32_t seq : seqs)
+      start.WriteHtonU32(seq);
+  }
+
+  uint32_t Deserialize(Buffer::Iterator start) override
+  {
+    seqs.resize(start.ReadNtohU16());
+    for (uint32_t &seq : seqs)
+      seq = start.ReadNtohU32();
+    return GetSerializedSize();
+  }
+
+  void Print(std::ostream &os) const override { os << seqs.size() << " delivered"; }
+
+  std::vector<uint32_t> seqs;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(ExorAckHeader);
+
+// One chain node. The user generates exorRate of traffic, relays forward
+// and the AP delivers the first copy of each packet.
+class ExorNode : public Application
+{
+public:
+  static TypeId GetTypeId()
+  {
+    static TypeId tid = TypeId("ns3::ExorNode").SetParent<Application>().AddConstructor<ExorNode>();
+    return tid;
+  }
+
+  void Setup(uint32_t index, Mac48Address address, const std::vector<Ipv4Address> &chain, bool opportunistic,
+             Time slot)
+  {
+    m_index = index;
+    m_address = address;
+    m_chain = chain;
+    m_opportunistic = opportunistic;
+    m_slot = slot;
+  }
+
+  // Count only packets the user sent from `from` on
+  void ResetCounters(Time from)
+  {
+    m_from = from;
+    m_delivered = 0;
+    m_duplicates = 0;
+    m_skips = 0;
+  }
+
+  uint64_t GetDelivered() const { return m_delivered; }
+  uint64_t GetDuplicates() const { return m_duplicates; }
+  uint64_t GetSkips() const { return m_skips; } // delivered in fewer transmissions than the chain has hops
+
+  // MonitorSnifferRx: frames between other chain nodes
+  void Overhear(Ptr<const Packet> p, uint16_t channelFreqMhz, WifiTxVector txVector, MpduInfo aMpdu,
+                SignalNoiseDbm signalNoise, uint16_t staId)
+  {
+    WifiMacHeader hdr;
+    Ptr<Packet> copy = PeekUdpDatagram(p, EXOR_PORT, hdr);
+    if (!copy || hdr.GetAddr1() == m_address)
+      return;
+    ExorHeader exor;
+    copy->RemoveHeader(exor);
+    Handle(exor, false);
+  }
+
+private:
+  void StartApplication() override
+  {
+    m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+    m_socket->Bind(InetSocketAddress(Ipv4Address::GetAny(), EXOR_PORT));
+    m_socket->SetRecvCallback(MakeCallback(&ExorNode::Receive, this));
+    if (m_index == 0)
+      m_sendEvent = Simulator::ScheduleNow(&ExorNode::Generate, this);
+    if (m_opportunistic && IsAp())
+      m_socket->SetAllowBroadcast(true);
+    else if (m_opportunistic && m_index > 0)
+      {
+        m_ackSocket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+        m_ackSocket->Bind(InetSocketAddress(Ipv4Address::GetAny(), EXOR_ACK_PORT));
+        m_ackSocket->SetRecvCallback(MakeCallback(&ExorNode::ReceiveAck, this));
+      }
+  }
+
+  void StopApplication() override
+  {
+    m_sendEvent.Cancel();
+    m_ackEvent.Cancel();
+    for (auto &pending : m_pending)
+      pending.second.Cancel();
+    m_socket->Close();
+    if (m_ackSocket)
+      m_ackSocket->Close();
+  }
+
+  bool IsAp() const { return m_index + 1 == m_chain.size(); }
+
+  void Generate()
+  {
+    ExorHeader exor;
+    exor.seq = m_seq++;
+    exor.sent = Simulator::Now();
+    Transmit(exor);
+    m_sendEvent =
+        Simulator::Schedule(DataRate(g_config.exorRate).CalculateBytesTxTime(m_size), &ExorNode::Generate, this);
+  }
+
+  void Transmit(ExorHeader exor)
+  {
+    m_pending.erase(exor.seq);
+    m_done.insert(exor.seq);
+    exor.from = m_index;
+    exor.hops++;
+    Ptr<Packet> p = Create<Packet>(m_size - exor.GetSerializedSize());
+    p->AddHeader(exor);
+    m_socket->SendTo(p, 0, InetSocketAddress(m_chain[m_index + 1], EXOR_PORT));
+  }
+
+  void Receive(Ptr<Socket> socket)
+  {
+    Ptr<Packet> p;
+    while ((p = socket->Recv()))
+      {
+        ExorHeader exor;
+        p->RemoveHeader(exor);
+        Handle(exor, true);
+      }
+  }
+
+  // The AP confirms its deliveries in batches
+  void SendAck()
+  {
+    Ptr<Packet> p = Create<Packet>();
+    p->AddHeader(m_ack);
+    m_socket->SendTo(p, 0, InetSocketAddress(Ipv4Address::GetBroadcast(), EXOR_ACK_PORT));
+    m_ack.seqs.clear();
+  }
+
+  void ReceiveAck(Ptr<Socket> socket)
+  {
+    Ptr<Packet> p;
+    while ((p = socket->Recv()))
+      {
+        ExorAckHeader ack;
+        p->RemoveHeader(ack);
+        for (uint32_t seq : ack.seqs)
+          Suppress(seq);
+      }
+  }
+
+  // Someone closer to the AP has packet `seq`: ours is redundant
+  void Suppress(uint32_t seq)
+  {
+    auto it = m_pending.find(seq);
+    if (it != m_pending.end())
+      {
+        it->second.Cancel();
+        m_pending.erase(it);
+      }
+    m_done.insert(seq);
+  }
+
+  // A copy of packet exor.seq, addressed to this node or overheard
+  void Handle(const ExorHeader &exor, bool addressed)
+  {
+    if (exor.from > m_index)
+      {
+        Suppress(exor.seq);
+        return;
+      }
+    if (exor.from == m_index || (!addressed && !m_opportunistic))
+      return;
+    if (m_done.count(exor.seq) || m_pending.count(exor.seq))
+      {
+        if (IsAp() && exor.sent >= m_from)
+          m_duplicates++;
+        return;
+      }
+
+    if (IsAp())
+      {
+        m_done.insert(exor.seq);
+        if (exor.sent >= m_from)
+          {
+            m_delivered++;
+            if (exor.hops + 1 < m_chain.size())
+              m_skips++;
+          }
+        if (m_opportunistic)
+          {
+            m_ack.seqs.push_back(exor.seq);
+            if (m_ack.seqs.size() == 1)
+              m_ackEvent = Simulator::Schedule(m_slot / 2, &ExorNode::SendAck, this);
+          }
+        return;
+      }
+    Time hold = m_opportunistic ? m_slot * (m_chain.size() - 1 - m_index) : Seconds(0);
+    m_pending[exor.seq] = Simulator::Schedule(hold, &ExorNode::Transmit, this, exor);
+  }
+
+  uint32_t m_index = 0;
+  Mac48Address m_address;
+  std::vector<Ipv4Address> m_chain; // user, relays, AP
+  bool m_opportunistic = false;
+  Time m_slot;
+  uint32_t m_size = 1000;
+  uint32_t m_seq = 0;
+  Time m_from;
+  Ptr<Socket> m_socket;
+  Ptr<Socket> m_ackSocket; // relays: the AP's batch maps
+  EventId m_sendEvent;
+  ExorAckHeader m_ack; // AP: delivered since the last batch map
+  EventId m_ackEvent;
+  std::map<uint32_t, EventId> m_pending; // held before forwarding
+  std::set<uint32_t> m_done;             // forwarded, delivered or taken over
+  uint64_t m_delivered = 0;
+  uint64_t m_duplicates = 0;
+  uint64_t m_skips = 0;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(ExorNode);
+
+// exorRate from a user through `nRelays` evenly spaced relays, each hop as
+// long as half of userDistance, to the AP. Returns {goodput (Mbit/s),
+// duplicates reaching the AP per delivered packet, share of deliveries that
+// skipped a hop somewhere, channel TX airtime share}.
+std::vector<double> MeasureExor(uint32_t nRelays, bool opportunistic)
+{
+  Topology topo;
+  topo.ap.Create(1);
+  topo.user.Create(1);
+  topo.relays.Create(nRelays);
+  BuildNetwork(topo, true);
+
+  Vector userPos((nRelays + 1) * g_config.userDistance / 2.0, 0.0, 0.0);
+  std::vector<Vector> relayPos = EvenlySpacedRelays(userPos, nRelays);
+  topo.ap.Get(0)->GetObject<MobilityModel>()->SetPosition(Vector(0.0, 0.0, 0.0));
+  topo.user.Get(0)->GetObject<MobilityModel>()->SetPosition(userPos);
+  for (uint32_t i = 0; i < nRelays; i++)
+    topo.relays.Get(i)->GetObject<MobilityModel>()->SetPosition(relayPos[i]);
+  EnablePhyStateTracing(topo);
+
+  // Chain order: user, relays from the user, AP
+  NetDeviceContainer devices(topo.devices.Get(0));
+  for (uint32_t i = 0; i < nRelays; i++)
+    devices.Add(topo.devices.Get(2 + i));
+  devices.Add(topo.devices.Get(1));
+  std::vector<Ipv4Address> addresses;
+  for (uint32_t i = 0; i < devices.GetN(); i++)
+    addresses.push_back(GetDeviceAddress(devices.Get(i)).first);
+
+  std::vector<Ptr<ExorNode>> nodes;
+  NodeContainer chain(topo.user, topo.relays, topo.ap);
+  for (uint32_t i = 0; i < chain.GetN(); i++)
+    {
+      Ptr<ExorNode> node = CreateObject<ExorNode>();
+      node->Setup(i, Mac48Address::ConvertFrom(devices.Get(i)->GetAddress()), addresses, opportunistic,
+                  g_config.exorSlot);
+      node->SetStartTime(Seconds(0.1));
+      chain.Get(i)->AddApplication(node);
+      if (opportunistic && i > 0)
+        FirstWifiPhy(chain.Get(i))
+            ->TraceConnectWithoutContext("MonitorSnifferRx", MakeCallback(&ExorNode::Overhear, node));
+      nodes.push_back(node);
+    }
+  Ptr<ExorNode> ap = nodes.back();
+
+  Simulator::Schedule(g_config.probeWarmup, [&]() {
+    ap->ResetCounters(Simulator::Now());
+    ResetPhyStates();
+  });
+  double channelTx = 0.0;
+  Time end = g_config.probeWarmup + g_config.probeTime;
+  Simulator::Schedule(end, [&]() {
+    for (const auto &entry : ChannelUtilization())
+      channelTx += entry.second.first;
+  });
+  Simulator::Stop(end);
+  Simulator::Run();
+
+  double delivered = ap->GetDelivered();
+  std::vector<double> result = {delivered * 1000 * 8.0 / g_config.probeTime.GetSeconds() / 1e6,
+                                delivered > 0 ? ap->GetDuplicates() / delivered : 0.0,
+                                delivered > 0 ? ap->GetSkips() / delivered : 0.0,
+                                channelTx};
+  Simulator::Destroy();
+  return result;
+}
+
+// Strict hop-by-hop against opportunistic forwarding on 3..6 hop chains
+void RunExor()
+{
+  NS_ABORT_MSG_IF(g_config.forwarding != "routed" || g_config.relayRadios != 1,
+                  "Opportunistic mode needs routed forwarding and single-radio relays");
+  const uint32_t minRelays = 2;
+  const uint32_t maxRelays = 5;
+  uint32_t chains = maxRelays - minRelays + 1;
+  std::vector<std::vector<double>> results = RunParallel(2 * chains, [&](uint32_t job) {
+    return MeasureExor(minRelays + job / 2, job % 2 == 1);
+  });
+
+  std::cout << "Opportunistic forwarding, " << g_config.exorRate << " offered, hops of "
+            << g_config.userDistance / 2.0 << " m, " << g_config.exorSlot.GetMilliSeconds() << " ms slots"
+            << std::endl;
+  for (uint32_t c = 0; c < chains; c++)
+    {
+      const std::vector<double> &strict = results[2 * c];
+      const std::vector<double> &exor = results[2 * c + 1];
+      std::cout << "  " << minRelays + c + 1 << " hops: strict " << strict[0] << " Mbps (airtime "
+                << 100.0 * strict[3] << "%), opportunistic " << exor[0] << " Mbps (airtime " << 100.0 * exor[3]
+                << "%, " << 100.0 * exor[2] << "% skipped a hop, " << exor[1] << " duplicates per packet), gain "
+                << RelayGain(strict[0], exor[0]) << "%" << std::endl;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Application-layer FEC
+//
+// Block FEC on the user's echo requests in the mobility run. Every fecBlock
+// requests the user sends are followed by repair packets; the AP recovers a
+// block's lost requests once as many of its packets (requests or repairs)
+// have arrived as it has requests. That is the erasure behaviour of a
+// Reed-Solomon or raptor code, which is all that matters here, so the repair
+// packets only carry the ids of the requests they protect. The number of
+// repairs per block follows the loss the monitor measured on the requests in
+// its last interval.
+// ---------------------------------------------------------------------------
+
+const uint16_t FEC_PORT = 9300;
+
+class FecHeader : public Header
+{
+public:
+  static TypeId GetTypeId()
+  {
+    static TypeId tid = TypeId("ns3::FecHeader").SetParent<Header>().AddConstructor<FecHeader>();
+    return tid;
+  }
+
+  TypeId GetInstanceTypeId() const override { return GetTypeId(); }
+
+  uint32_t GetSerializedSize() const override { return 6 + 8 * sources.size(); }
+
+  void Serialize(Buffer::Iterator start) const override
+  {
+    start.WriteHtonU32(block);
+    start.WriteHtonU16(sources.size());
+    for (uint64_t uid : sources)
+      start.WriteHtonU64(uid);
+  }
+
+  uint32_t Deserialize(Buffer::Iterator start) override
+  {
+    block = start.ReadNtohU32();
+    sources.resize(start.ReadNtohU16());
+    for (uint64_t &uid : sources)
+      uid = start.ReadNtohU64();
+    return GetSerializedSize();
+  }
+
+  void Print(std::ostream &os) const override { os << "block=" << block << " k=" << sources.size(); }
+
+  uint32_t block = 0;
+  std::vector<uint64_t> sources; // uids of the echo requests in the block
+};
+
+NS_OBJECT_ENSURE_REGISTERED(FecHeader);
+
+// User side: collects the echo requests into blocks and sends the repairs
+class FecEncoder : public Application
+{
+public:
+  static TypeId GetTypeId()
+  {
+    static TypeId tid = TypeId("ns3::FecEncoder").SetParent<Application>().AddConstructor<FecEncoder>();
+    return tid;
+  }
+
+  void Setup(Ipv4Address ap, uint32_t blockSize, uint32_t packetSize)
+  {
+    m_ap = ap;
+    m_blockSize = std::max(1u, blockSize);
+    m_packetSize = packetSize;
+  }
+
+  // Size the repairs for a measured request loss ratio: the expected losses
+  // in a block plus fecMinRepair, at most fecMaxRepair
+  void SetLoss(double loss)
+  {
+    double expected = loss < 1.0 ? m_blockSize * loss / (1.0 - loss) : g_config.fecMaxRepair;
+    m_repairs = std::min<uint32_t>(g_config.fecMaxRepair, g_config.fecMinRepair + (uint32_t)std::ceil(expected));
+  }
+
+  uint32_t GetRepairs() const { return m_repairs; }
+  uint64_t GetRepairsSent() const { return m_repairsSent; }
+
+  // Tx trace of the echo client
+  void SourceSent(Ptr<const Packet> p)
+  {
+    m_block.sources.push_back(p->GetUid());
+    if (m_block.sources.size() < m_blockSize)
+      return;
+    for (uint32_t i = 0; i < m_repairs; i++)
+      {
+        Ptr<Packet> repair = Create<Packet>(m_packetSize);
+        repair->AddHeader(m_block);
+        m_socket->SendTo(repair, 0, InetSocketAddress(m_ap, FEC_PORT));
+        m_repairsSent++;
+      }
+    m_block.block++;
+    m_block.sources.clear();
+  }
+
+private:
+  void StartApplication() override
+  {
+    m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+    m_socket->Bind();
+  }
+
+  void StopApplication() override { m_socket->Close(); }
+
+  Ipv4Address m_ap;
+  uint32_t m_blockSize = 4;
+  uint32_t m_packetSize = 1024;
+  uint32_t m_repairs = 1;
+  FecHeader m_block; // requests sent since the last repairs
+  uint64_t m_repairsSent = 0;
+  Ptr<Socket> m_socket;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(FecEncoder);
+
+// AP side: counts what arrived of every block and recovers the rest of the
+// block's requests once enough has
+class FecDecoder : public Application
+{
+public:
+  static TypeId GetTypeId()
+  {
+    static TypeId tid = TypeId("ns3::FecDecoder").SetParent<Application>().AddConstructor<FecDecoder>();
+    return tid;
+  }
+
+  uint64_t GetRecovered() const { return m_recovered; }
+
+  // Rx trace of the echo server
+  void SourceReceived(Ptr<const Packet> p, const Address &)
+  {
+    m_received.insert(p->GetUid());
+    auto it = m_blockOf.find(p->GetUid());
+    if (it != m_blockOf.end())
+      TryDecode(it->second);
+  }
+
+private:
+  struct Block
+  {
+    std::vector<uint64_t> sources;
+    uint32_t repairs = 0;
+    bool done = false;
+  };
+
+  void StartApplication() override
+  {
+    m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+    m_socket->Bind(InetSocketAddress(Ipv4Address::GetAny(), FEC_PORT));
+    m_socket->SetRecvCallback(MakeCallback(&FecDecoder::Receive, this));
+  }
+
+  void StopApplication() override { m_socket->Close(); }
+
+  void Receive(Ptr<Socket> socket)
+  {
+    Ptr<Packet> p;
+    while ((p = socket->Recv()))
+      {
+        FecHeader fec;
+        p->RemoveHeader(fec);
+        Block &block = m_blocks[fec.block];
+        if (block.sources.empty())
+          {
+            block.sources = fec.sources;
+            for (uint64_t uid : fec.sources)
+              m_blockOf[uid] = fec.block;
+          }
+        block.repairs++;
+        TryDecode(fec.block);
+      }
+  }
+
+  void TryDecode(uint32_t id)
+  {
+    Block &block = m_blocks[id];
+    if (block.done)
+      return;
+    uint32_t arrived = block.repairs;
+    for (uint64_t uid : block.sources)
+      arrived += m_received.count(uid);
+    if (arrived < block.sources.size())
+      return;
+    block.done = true;
+    for (uint64_t uid : block.sources)
+      if (!m_received.count(uid) && g_delivered.emplace(uid, Simulator::Now()).second)
+        m_recovered++;
+  }
+
+  Ptr<Socket> m_socket;
+  std::map<uint32_t, Block> m_blocks;
+  std::map<uint64_t, uint32_t> m_blockOf;
+  std::set<uint64_t> m_received;
+  uint64_t m_recovered = 0;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(FecDecoder);
+
+Ptr<FecEncoder> g_fecEncoder;
+Ptr<FecDecoder> g_fecDecoder;
+
+// ---------------------------------------------------------------------------
+// Drone deployment
+//
+// Drones wait on the ground at the AP. Once deployed they climb to
+// droneAltitude, fly to their relay point with a trapezoidal speed profile
+// (droneAccel up to droneSpeed and back down) and only start relaying when
+// the whole chain has arrived, so the outage while en route is measured.
+// ---------------------------------------------------------------------------
+
+Topology g_topo;
+
+// Horizontal leg of a flight that starts and ends at rest
+struct FlightLeg
+{
+  double distance;
+  double accelTime;
+  double peakSpeed;
+  double cruiseTime;
+
+  explicit FlightLeg(double d) : distance(d)
+  {
+    double a = g_config.droneAccel;
+    double v = g_config.droneSpeed;
+    if (v * v / a > distance)
+      {
+        // Too short to reach cruise speed: accelerate half way, then brake
+        accelTime = std::sqrt(distance / a);
+        peakSpeed = a * accelTime;
+        cruiseTime = 0.0;
+      }
+    else
+      {
+        accelTime = v / a;
+        peakSpeed = v;
+        cruiseTime = (distance - v * v / a) / v;
+      }
+  }
+
+  double Duration() const { return 2 * accelTime + cruiseTime; }
+
+  // Distance covered `t` seconds into the leg
+  double Travelled(double t) const
+  {
+    double a = g_config.droneAccel;
+    if (t < accelTime)
+      return 0.5 * a * t * t;
+    if (t < accelTime + cruiseTime)
+      return 0.5 * a * accelTime * accelTime + peakSpeed * (t - accelTime);
+    double remaining = std::max(0.0, Duration() - t);
+    return distance - 0.5 * a * remaining * remaining;
+  }
+};
+
+// Time needed to climb from `from` to the altitude of `to` and fly there
+Time FlightTime(const Vector &from, const Vector &to)
+{
+  double climb = std::abs(to.z - from.z) / g_config.climbRate;
+  FlightLeg leg(std::hypot(to.x - from.x, to.y - from.y));
+  return Seconds(climb + leg.Duration());
+}
+
+// Queue waypoints for a flight starting now; returns the arrival time
+Time ScheduleFlight(Ptr<WaypointMobilityModel> mob, const Vector &to)
+{
+  Vector from = mob->GetPosition();
+  Time t = Simulator::Now();
+  mob->AddWaypoint(Waypoint(t, from));
+
+  Vector top(from.x, from.y, to.z);
+  double climb = std::abs(to.z - from.z) / g_config.climbRate;
+  if (climb > 0)
+    {
+      t += Seconds(climb);
+      mob->AddWaypoint(Waypoint(t, top));
+    }
+
+  double dx = to.x - from.x;
+  double dy = to.y - from.y;
+  FlightLeg leg(std::hypot(dx, dy));
+  if (leg.distance > 0)
+    {
+      // Waypoints are linear in between, so sample the speed profile finely
+      double step = g_config.flightStep.GetSeconds();
+      for (double s = step; s < leg.Duration(); s += step)
+        {
+          double f = leg.Travelled(s) / leg.distance;
+          mob->AddWaypoint(Waypoint(t + Seconds(s), Vector(top.x + f * dx, top.y + f * dy, top.z)));
+        }
+      t += Seconds(leg.Duration());
+      mob->AddWaypoint(Waypoint(t, to));
+    }
+  return t;
+}
+
+// Completion time and duration of every HWMP path discovery in mesh mode
+std::vector<std::pair<Time, Time>> g_pathDiscoveries;
+
+void PathDiscoveryTrace(Time duration)
+{
+  g_pathDiscoveries.push_back(std::make_pair(Simulator::Now(), duration));
+  if (!g_config.quiet)
+    std::cout << Simulator::Now().GetSeconds() << "s: HWMP path discovered in " << duration.GetMilliSeconds()
+              << " ms" << std::endl;
+}
+
+void EnablePathDiscoveryTracing()
+{
+  for (NodeList::Iterator it = NodeList::Begin(); it != NodeList::End(); ++it)
+    {
+      for (uint32_t i = 0; i < (*it)->GetNDevices(); i++)
+        {
+          Ptr<dot11s::HwmpProtocol> hwmp = (*it)->GetDevice(i)->GetObject<dot11s::HwmpProtocol>();
+          if (hwmp)
+            hwmp->TraceConnectWithoutContext("RouteDiscoveryTime", MakeCallback(&PathDiscoveryTrace));
+        }
+    }
+}
+
+// Association changes of the user's STA: time of the last disassociation and
+// the gap until each following association
+Time g_deassocTime;
+bool g_deassociated = false;
+std::vector<Time> g_reassocGaps;
+
+void AssocTrace(Mac48Address bssid)
+{
+  if (g_deassociated)
+    g_reassocGaps.push_back(Simulator::Now() - g_deassocTime);
+  if (!g_config.quiet)
+    {
+      auto it = g_macToNode.find(bssid);
+      std::cout << Simulator::Now().GetSeconds() << "s: user associated with "
+                << (it != g_macToNode.end() ? NodeName(it->second) : "unknown AP");
+      if (g_deassociated)
+        std::cout << " after " << (Simulator::Now() - g_deassocTime).GetMilliSeconds() << " ms";
+      std::cout << std::endl;
+    }
+  g_deassociated = false;
+}
+
+void DeAssocTrace(Mac48Address bssid)
+{
+  g_deassocTime = Simulator::Now();
+  g_deassociated = true;
+}
+
+void EnableAssociationTracing(const Topology &topo)
+{
+  Ptr<WifiNetDevice> dev = DynamicCast<WifiNetDevice>(topo.devices.Get(0));
+  Ptr<StaWifiMac> sta = dev ? DynamicCast<StaWifiMac>(dev->GetMac()) : nullptr;
+  if (!sta)
+    return;
+  sta->TraceConnectWithoutContext("Assoc", MakeCallback(&AssocTrace));
+  sta->TraceConnectWithoutContext("DeAssoc", MakeCallback(&DeAssocTrace));
+}
+
+// Mean time (s) from losing an association to the next one, or -1
+double MeanReassociationTime()
+{
+  Time total;
+  for (const Time &gap : g_reassocGaps)
+    total += gap;
+  return g_reassocGaps.empty() ? -1.0 : total.GetSeconds() / g_reassocGaps.size();
+}
+
+// Print count, min, median, 90th percentile and max of `values` (seconds) in ms
+void PrintLatencyDistribution(const std::string &label, std::vector<double> values)
+{
+  if (values.empty())
+    {
+      std::cout << label << ": none" << std::endl;
+      return;
+    }
+  std::sort(values.begin(), values.end());
+  auto percentile = [&](double q) { return 1000.0 * values[(size_t)std::round(q * (values.size() - 1))]; };
+  std::cout << label << ": n=" << values.size() << ", min " << percentile(0.0) << " ms, median " << percentile(0.5)
+            << " ms, p90 " << percentile(0.9) << " ms, max " << percentile(1.0) << " ms" << std::endl;
+}
+
+// Time (s) from the drones powering on at arrival to the first path
+// discovery completed after that, or -1 if there was none
+double FirstPathDiscoveryAfterArrival()
+{
+  for (const auto &discovery : g_pathDiscoveries)
+    if (g_deployment.usable && discovery.first >= g_deployment.usableTime)
+      return (discovery.first - g_deployment.usableTime).GetSeconds();
+  return -1.0;
+}
+
+// Mean duration (s) of the path discoveries completed once the relay chain
+// was in place (and powered on), or -1 if there were none
+double MeanPathDiscoveryAfterArrival()
+{
+  Time total;
+  uint32_t count = 0;
+  for (const auto &discovery : g_pathDiscoveries)
+    if (g_deployment.usable && discovery.first >= g_deployment.usableTime)
+      {
+        total += discovery.second;
+        count++;
+      }
+  return count ? total.GetSeconds() / count : -1.0;
+}
+
+// Directed handover: retune the user to the drone APs' access channel. The
+// STA drops its association on the channel switch and scans there at once
+// instead of waiting for maxMissedBeacons beacons from the AP to go missing.
+void DirectHandover()
+{
+  std::ostringstream channelSettings;
+  channelSettings << "{" << DroneAccessChannel() << ", " << GetRadioProfile(g_config.relayRadio).channelWidth
+                  << ", BAND_5GHZ, 0}";
+  FirstWifiPhy(g_user)->SetAttribute("ChannelSettings", StringValue(channelSettings.str()));
+  if (!g_config.quiet)
+    std::cout << Simulator::Now().GetSeconds() << "s: controller directs the user to channel "
+              << DroneAccessChannel() << std::endl;
+}
+
+// Relays inserted into or removed from the mobility run's topology
+struct TopologyChange
+{
+  Time at;
+  std::string what;
+};
+
+std::vector<TopologyChange> g_topologyChanges;
+
+void RecordTopologyChange(const std::string &what)
+{
+  g_topologyChanges.push_back({Simulator::Now(), what});
+}
+
+// Convergence after the topology change at `at`, looking at the echo requests
+// sent before `until`: time from the change to the arrival of the first of
+// them delivered (-1 if none was) and how many of those sent before it were lost
+std::pair<double, uint64_t> ConvergenceAfter(Time at, Time until)
+{
+  uint64_t lost = 0;
+  for (const auto &sent : g_sentAt)
+    {
+      if (sent.second < at || sent.second >= until)
+        continue;
+      auto delivered = g_delivered.find(sent.first);
+      if (delivered != g_delivered.end())
+        return std::make_pair((delivered->second - at).GetSeconds(), lost);
+      lost++;
+    }
+  return std::make_pair(-1.0, lost);
+}
+
+// Switch every radio of the drones (access, backhaul and mesh interfaces) off
+// or back on
+void SetRelayRadios(bool on)
+{
+  for (uint32_t i = 0; i < g_topo.relays.GetN(); i++)
+    {
+      Ptr<Node> relay = g_topo.relays.Get(i);
+      for (uint32_t d = 0; d < relay->GetNDevices(); d++)
+        {
+          Ptr<WifiNetDevice> dev = DynamicCast<WifiNetDevice>(relay->GetDevice(d));
+          if (!dev)
+            continue;
+          if (on)
+            dev->GetPhy()->ResumeFromOff();
+          else
+            dev->GetPhy()->SetOffMode();
+        }
+    }
+}
+
+// Backhaul path (user, relay points, AP) of the current deployment, for the
+// channel assignment once the drones' radios are on
+std::vector<Vector> g_deploymentPath;
+
+// Drones leave the chain (battery swap): their radios go off, and with static
+// routing the controller removes the relay routes at the same time
+void RecallDrones()
+{
+  if (g_config.forwarding == "routed" && g_config.routing == "static" && g_deployment.usable)
+    RemoveRelayRoutes(g_topo);
+  SetRelayRadios(false);
+  g_deployment.recalled = true;
+  RecordTopologyChange("relays removed");
+  if (!g_config.quiet)
+    std::cout << Simulator::Now().GetSeconds() << "s: drones recalled" << std::endl;
+}
+
+// The drones' radios stay off in flight and come on here, so the relays join
+// the network only once they are on station: bridged drones repeating the
+// AP's SSID cannot pick up the user at the AP, mesh drones join as new mesh
+// points and routing protocols first see them now. The insertion is timed
+// from this power-on.
+void OnChainArrived()
+{
+  if (g_deployment.recalled)
+    return;
+  SetRelayRadios(true);
+  AssignHopChannels(g_topo, g_deploymentPath);
+  RecordTopologyChange("relays inserted");
+  // The controller sees every node, so it sets up the whole chain in this one
+  // event: no packet can see a partially installed path
+  if (g_config.forwarding == "routed" && g_config.routing == "static")
+    {
+      InstallRelayRoutes(g_topo);
+      if (g_config.prepopulateArp)
+        PopulateHopArp(g_topo);
+    }
+  else if (g_config.forwarding == "bridged" && g_config.handover == "directed")
+    DirectHandover();
+  g_deployment.usable = true;
+  g_deployment.usableTime = Simulator::Now();
+  if (!g_config.quiet)
+    std::cout << Simulator::Now().GetSeconds() << "s: relay chain in place, "
+              << (Simulator::Now() - g_deployment.triggerTime).GetSeconds() << "s after deployment" << std::endl;
+}
+
+// Relay points for a user at `userPos`: evenly spaced on the AP-user line, at droneAltitude
+std::vector<Vector> RelayTargets(const Vector &userPos)
+{
+  return EvenlySpacedRelays(userPos, g_topo.relays.GetN());
+}
+
+// Launch every drone towards its relay point for a user at `userPos`; the
+// relay becomes usable when the last one arrives
+void DeployDrones(const Vector &userPos)
+{
+  g_deployment.triggered = true;
+  g_deployment.triggerTime = Simulator::Now();
+  g_deployment.txAtTrigger = g_txPackets;
+  g_deployment.rxAtTrigger = g_rxPackets;
+
+  std::vector<Vector> targets = RelayTargets(userPos);
+  g_deploymentPath.assign(1, userPos);
+  g_deploymentPath.insert(g_deploymentPath.end(), targets.begin(), targets.end());
+  g_deploymentPath.push_back(g_ap->GetObject<MobilityModel>()->GetPosition());
+
+  Time arrival = Simulator::Now();
+  for (uint32_t i = 0; i < g_topo.relays.GetN(); i++)
+    {
+      Ptr<WaypointMobilityModel> mob = g_topo.relays.Get(i)->GetObject<WaypointMobilityModel>();
+      arrival = std::max(arrival, ScheduleFlight(mob, targets[i]));
+    }
+  if (!g_config.quiet)
+    std::cout << Simulator::Now().GetSeconds() << "s: deploying " << g_topo.relays.GetN()
+              << " drone(s), expected on station at " << arrival.GetSeconds() << "s" << std::endl;
+  Simulator::Schedule(arrival - Simulator::Now(), &OnChainArrived);
+}
+
+// Predictive trigger: extrapolate the user's constant velocity, find when the
+// predicted RSS from the AP falls below degradeRss, and launch once the
+// flight to the relay points laid out for that position takes (almost) as
+// long as the time left, so the chain arrives just before the link degrades
+void PredictDeployment()
+{
+  if (g_deployment.triggered)
+    return;
+
+  Ptr<ConstantVelocityMobilityModel> userMob = g_user->GetObject<ConstantVelocityMobilityModel>();
+  Ptr<MobilityModel> apMob = g_ap->GetObject<MobilityModel>();
+  double txPower = FirstWifiPhy(g_ap)->GetTxPowerStart();
+  Vector pos = userMob->GetPosition();
+  Vector vel = userMob->GetVelocity();
+
+  Ptr<ConstantPositionMobilityModel> predicted = CreateObject<ConstantPositionMobilityModel>();
+  for (Time t = Seconds(0); t <= g_config.predictHorizon; t += g_config.predictStep)
+    {
+      double s = t.GetSeconds();
+      Vector userAt(pos.x + vel.x * s, pos.y + vel.y * s, pos.z + vel.z * s);
+      predicted->SetPosition(userAt);
+      if (g_lossModel->CalcRxPower(txPower, apMob, predicted) >= g_config.degradeRss)
+        continue;
+
+      // Link degrades t from now; launch if the chain would barely make it
+      std::vector<Vector> targets = RelayTargets(userAt);
+      Time flight = Seconds(0);
+      for (uint32_t i = 0; i < g_topo.relays.GetN(); i++)
+        flight = std::max(flight, FlightTime(g_topo.relays.Get(i)->GetObject<MobilityModel>()->GetPosition(), targets[i]));
+      if (t <= flight + g_config.predictMargin)
+        {
+          if (!g_config.quiet)
+            std::cout << Simulator::Now().GetSeconds() << "s: link predicted to degrade in " << s
+                      << "s at " << userAt.x << "m, flight takes " << flight.GetSeconds() << "s" << std::endl;
+          DeployDrones(userAt);
+          return;
+        }
+      break;
+    }
+  Simulator::Schedule(g_config.predictStep, &PredictDeployment);
+}
+
+// Time the user spent losing packets (the send interval after every lost
+// echo request) and the number of requests lost, over the whole run
+std::pair<Time, uint64_t> MeasureOutage()
+{
+  std::vector<Time> sendTimes;
+  std::vector<bool> lost;
+  for (const auto &sent : g_sentAt)
+    {
+      sendTimes.push_back(sent.second);
+      lost.push_back(g_delivered.count(sent.first) == 0);
+    }
+
+  Time outage = Seconds(0);
+  uint64_t lostPackets = 0;
+  for (size_t i = 0; i < sendTimes.size(); i++)
+    {
+      if (!lost[i])
+        continue;
+      lostPackets++;
+      if (i + 1 < sendTimes.size())
+        outage += sendTimes[i + 1] - sendTimes[i];
+      else if (i > 0)
+        outage += sendTimes[i] - sendTimes[i - 1];
+    }
+  return std::make_pair(outage, lostPackets);
+}
+
+// `runLost` is the number of requests lost over the whole run
+void PrintDeploymentSummary(uint64_t runLost)
+{
+  if (!g_deployment.triggered)
+    {
+      std::cout << "Deployment: never triggered" << std::endl;
+      return;
+    }
+  std::cout << "Deployment: triggered at " << g_deployment.triggerTime.GetSeconds() << "s";
+  if (g_deployment.usable)
+    std::cout << ", relay usable after " << (g_deployment.usableTime - g_deployment.triggerTime).GetSeconds() << "s";
+  std::cout << std::endl;
+
+  if (!g_deployment.recovered)
+    {
+      std::cout << "Recovery: no packet delivered through the relay" << std::endl;
+      return;
+    }
+  uint64_t sent = g_deployment.txAtRecovery - g_deployment.txAtTrigger;
+  uint64_t delivered = g_deployment.rxAtRecovery - g_deployment.rxAtTrigger;
+  uint64_t lost = sent > delivered ? sent - delivered : 0;
+  NS_ASSERT_MSG(lost <= runLost, "Deployment lost " << lost << " requests but the run only " << runLost);
+  std::cout << "Recovery: time-to-recover " << (g_deployment.recoveredTime - g_deployment.triggerTime).GetSeconds()
+            << "s (path set up " << (g_deployment.recoveredTime - g_deployment.usableTime).GetSeconds()
+            << "s after the chain was in place), " << lost << " of " << sent << " packets lost meanwhile ("
+            << lost * 1024 / 1000.0 << " kB of goodput)" << std::endl;
+}
 
 // Periodically print network stats
 void Monitor(Time interval)
 {
+  static uint64_t lastTx = 0;
+  static uint64_t lastRx = 0;
+  static uint64_t lastRecovered = 0;
+
   Ptr<MobilityModel> userMob = g_user->GetObject<MobilityModel>();
   Ptr<MobilityModel> apMob = g_ap->GetObject<MobilityModel>();
   double distance = userMob->GetDistanceFrom(apMob);
@@ -33,79 +4340,152 @@ void Monitor(Time interval)
     lossRate = 100.0 * (1.0 - (double)g_rxPackets / g_txPackets);
 
   // Print timestamp, distance, and loss
-  std::cout << Simulator::Now().GetSeconds() << "s: "
-            << "Distance=" << distance << "m, "
-            << "Tx=" << g_txPackets << ", Rx=" << g_rxPackets
-            << " (" << lossRate << "% loss)"
-            << std::endl;
+  if (!g_config.quiet)
+    std::cout << Simulator::Now().GetSeconds() << "s: "
+              << "Distance=" << distance << "m, "
+              << "Tx=" << g_txPackets << ", Rx=" << g_rxPackets
+              << " (" << lossRate << "% loss)"
+              << std::endl;
+  ReportLinkRates();
+  ReportQueues();
+  std::pair<uint64_t, uint64_t> drops = ReportLossCauses();
+  ReportPhyStates();
+
+  // Loss-based trigger: deploy once the loss over the last interval is too
+  // high (and, with fixableLossOnly, mostly due to causes a relay can fix).
+  // Requests FEC recovered count as delivered; the repairs are sized by the
+  // loss before recovery.
+  uint64_t windowTx = g_txPackets - lastTx;
+  uint64_t windowRx = g_rxPackets - lastRx;
+  lastTx = g_txPackets;
+  lastRx = g_rxPackets;
+  if (g_fecEncoder)
+    {
+      if (windowTx > 0)
+        g_fecEncoder->SetLoss(1.0 - std::min(1.0, (double)windowRx / windowTx));
+      uint64_t windowRecovered = g_fecDecoder->GetRecovered() - lastRecovered;
+      lastRecovered = g_fecDecoder->GetRecovered();
+      if (!g_config.quiet)
+        std::cout << "  FEC: " << windowRecovered << " requests recovered, " << g_fecEncoder->GetRepairs()
+                  << " repairs per " << g_config.fecBlock << " requests next" << std::endl;
+      windowRx += windowRecovered;
+    }
+  bool fixable = !g_config.fixableLossOnly || drops.first > drops.second;
+  if (g_config.trigger == "loss" && !g_deployment.triggered && windowTx > 0 &&
+      1.0 - (double)windowRx / windowTx >= g_config.lossThreshold && fixable)
+    DeployDrones(userMob->GetPosition());
 
   // Schedule next check
   Simulator::Schedule(interval, &Monitor, interval);
 }
 
-int main(int argc, char *argv[])
+// Outcome of one mobility run. Times are in seconds, -1 where they do not apply.
+struct MobilityResult
 {
-  Time::SetResolution(Time::NS);
-  LogComponentEnable("UdpEchoClientApplication", LOG_LEVEL_INFO);
-  LogComponentEnable("UdpEchoServerApplication", LOG_LEVEL_INFO);
-
-  NodeContainer baseStation;
-  baseStation.Create(1);
-  NodeContainer user;
-  user.Create(1);
-  g_user = user.Get(0);
-  g_ap = baseStation.Get(0);
+  double outage = 0.0;
+  double lost = 0.0; // echo requests
+  double triggerTime = -1.0;
+  double pathSetup = -1.0; // first delivery through the relays after they arrived
+  double meanDiscovery = -1.0; // HWMP, after arrival
+  double firstDiscovery = -1.0; // from the drones powering on to the first HWMP path
+  double meanReassociation = -1.0;
+  double insertionConvergence = -1.0;
+  double insertionLost = 0.0;
+  double removalConvergence = -1.0;
+  double removalLost = 0.0;
+  double fecRepairs = 0.0; // repair packets sent
+  double fecRecovered = 0.0; // requests recovered
 
-  // Channel + PHY
-  YansWifiChannelHelper channel = YansWifiChannelHelper::Default();
-  YansWifiPhyHelper phy;
-  phy.SetChannel(channel.Create());
+  // Fields in the order RunParallel carries them
+  static std::vector<double MobilityResult::*> Fields()
+  {
+    return {&MobilityResult::outage, &MobilityResult::lost, &MobilityResult::triggerTime,
+            &MobilityResult::pathSetup, &MobilityResult::meanDiscovery, &MobilityResult::meanReassociation,
+            &MobilityResult::insertionConvergence, &MobilityResult::insertionLost,
+            &MobilityResult::removalConvergence, &MobilityResult::removalLost, &MobilityResult::fecRepairs,
+            &MobilityResult::fecRecovered, &MobilityResult::firstDiscovery};
+  }
 
-  WifiHelper wifi;
-  wifi.SetStandard(WIFI_STANDARD_80211n);
-  WifiMacHelper mac;
+  std::vector<double> ToValues() const
+  {
+    std::vector<double> values;
+    for (double MobilityResult::*field : Fields())
+      values.push_back(this->*field);
+    return values;
+  }
 
-  Ssid ssid("base-ap");
-  mac.SetType("ns3::StaWifiMac",
-              "Ssid", SsidValue(ssid),
-              "ActiveProbing", BooleanValue(false));
-  NetDeviceContainer userDevice = wifi.Install(phy, mac, user);
+  static MobilityResult FromValues(const std::vector<double> &values)
+  {
+    MobilityResult result;
+    std::vector<double MobilityResult::*> fields = Fields();
+    for (size_t i = 0; i < fields.size() && i < values.size(); i++)
+      result.*fields[i] = values[i];
+    return result;
+  }
+};
 
-  mac.SetType("ns3::ApWifiMac", "Ssid", SsidValue(ssid));
-  NetDeviceContainer apDevice = wifi.Install(phy, mac, baseStation);
+// The user moves away from the AP at constant speed while exchanging UDP
+// echo packets with it
+MobilityResult RunMobility()
+{
+  if (!g_config.quiet)
+    {
+      LogComponentEnable("UdpEchoClientApplication", LOG_LEVEL_INFO);
+      LogComponentEnable("UdpEchoServerApplication", LOG_LEVEL_INFO);
+    }
 
-  // Mobility
-  MobilityHelper mobility;
-  mobility.SetMobilityModel("ns3::ConstantVelocityMobilityModel");
-  mobility.Install(user);
-  mobility.Install(baseStation);
+  Topology &topo = g_topo;
+  topo.ap.Create(1);
+  topo.user.Create(1);
+  g_user = topo.user.Get(0);
+  g_ap = topo.ap.Get(0);
 
-  user.Get(0)->GetObject<ConstantVelocityMobilityModel>()->SetPosition(Vector(0.0, 0.0, 0.0));
-  user.Get(0)->GetObject<ConstantVelocityMobilityModel>()->SetVelocity(Vector(5.0, 0.0, 0.0)); // 5 m/s away from spawn
+  // Drones relay over host routes, which needs the ad-hoc network; the
+  // baseline without them can use it too, to differ only in the drones
+  bool deploy = g_config.trigger != "";
+  bool adhoc = deploy || g_config.adhocBaseline;
+  if (deploy)
+    {
+      topo.relays.Create(g_config.drones);
+      topo.relayMobility = "ns3::WaypointMobilityModel";
+    }
+  BuildNetwork(topo, adhoc);
 
-  baseStation.Get(0)->GetObject<MobilityModel>()->SetPosition(Vector(0.0, 0.0, 0.0));
+  if (g_config.traceMode == "record")
+    EnableLinkRecording();
+  else if (g_config.traceMode == "replay")
+    EnableLinkReplay();
+  EnableRateTracing();
+  EnableQueueTracing(topo);
+  EnablePhyStateTracing(topo);
+  EnableLossTracing();
+  EnablePathDiscoveryTracing();
+  EnableAssociationTracing(topo);
 
-  InternetStackHelper stack;
-  stack.Install(user);
-  stack.Install(baseStation);
+  g_user->GetObject<ConstantVelocityMobilityModel>()->SetPosition(Vector(0.0, 0.0, 0.0));
+  g_user->GetObject<ConstantVelocityMobilityModel>()->SetVelocity(Vector(5.0, 0.0, 0.0)); // 5 m/s away from spawn
 
-  Ipv4AddressHelper address;
-  address.SetBase("10.1.1.0", "255.255.255.0");
-  Ipv4InterfaceContainer interfaces = address.Assign(NetDeviceContainer(userDevice, apDevice));
+  g_ap->GetObject<MobilityModel>()->SetPosition(Vector(0.0, 0.0, 0.0));
+  for (uint32_t i = 0; i < topo.relays.GetN(); i++)
+    topo.relays.Get(i)->GetObject<MobilityModel>()->SetPosition(Vector(0.0, 0.0, 0.0));
+  // Off until on station (see OnChainArrived): at t=0, after the devices have
+  // initialised but before their first frame
+  if (deploy)
+    Simulator::Schedule(Seconds(0), &SetRelayRadios, false);
 
   // UDP Echo
   uint16_t port = 9;
   UdpEchoServerHelper echoServer(port);
-  ApplicationContainer serverApps = echoServer.Install(baseStation.Get(0));
+  ApplicationContainer serverApps = echoServer.Install(g_ap);
   serverApps.Start(Seconds(1.0));
   serverApps.Stop(Seconds(60.0));
 
-  UdpEchoClientHelper echoClient(interfaces.GetAddress(1), port);
+  UdpEchoClientHelper echoClient(topo.ApAddress(), port);
   echoClient.SetAttribute("MaxPackets", UintegerValue(1000));
   echoClient.SetAttribute("Interval", TimeValue(Seconds(0.5)));
   echoClient.SetAttribute("PacketSize", UintegerValue(1024));
 
-  ApplicationContainer clientApps = echoClient.Install(user.Get(0));
+  ApplicationContainer clientApps = echoClient.Install(g_user);
   clientApps.Start(Seconds(2.0));
   clientApps.Stop(Seconds(60.0));
 
@@ -116,13 +4496,457 @@ int main(int argc, char *argv[])
   clientApp->TraceConnectWithoutContext("Tx", MakeCallback(&TxTrace));
   serverApp->TraceConnectWithoutContext("Rx", MakeCallback(&RxTrace));
 
+  if (g_config.fec)
+    {
+      g_fecEncoder = CreateObject<FecEncoder>();
+      g_fecEncoder->Setup(topo.ApAddress(), g_config.fecBlock, 1024);
+      g_fecEncoder->SetLoss(0.0);
+      g_fecEncoder->SetStartTime(Seconds(1.0));
+      g_user->AddApplication(g_fecEncoder);
+      g_fecDecoder = CreateObject<FecDecoder>();
+      g_fecDecoder->SetStartTime(Seconds(1.0));
+      g_ap->AddApplication(g_fecDecoder);
+      clientApp->TraceConnectWithoutContext("Tx", MakeCallback(&FecEncoder::SourceSent, g_fecEncoder));
+      serverApp->TraceConnectWithoutContext("Rx", MakeCallback(&FecDecoder::SourceReceived, g_fecDecoder));
+    }
+
   // Start periodic monitoring
   Simulator::Schedule(Seconds(2.0), &Monitor, Seconds(2.0));
+  if (g_config.trigger == "predictive")
+    Simulator::Schedule(Seconds(2.0), &PredictDeployment);
+  if (deploy && g_config.recallTime.IsStrictlyPositive())
+    Simulator::Schedule(g_config.recallTime, &RecallDrones);
 
-  phy.EnablePcapAll("drone_wifi_simulation");
+  if (!g_config.quiet)
+    topo.phy.EnablePcapAll("drone_wifi_simulation");
 
   Simulator::Stop(Seconds(60.0));
   Simulator::Run();
+  uint64_t repairs = g_fecEncoder ? g_fecEncoder->GetRepairsSent() : 0;
+  uint64_t recovered = g_fecDecoder ? g_fecDecoder->GetRecovered() : 0;
+  g_fecEncoder = nullptr;
+  g_fecDecoder = nullptr;
   Simulator::Destroy();
+
+  std::pair<Time, uint64_t> outage = MeasureOutage();
+  if (!g_config.quiet)
+    {
+      if (deploy)
+        PrintDeploymentSummary(outage.second);
+      std::cout << "Outage: " << outage.first.GetSeconds() << "s, " << outage.second << " echo requests lost"
+                << std::endl;
+      if (g_config.fec)
+        std::cout << "FEC: " << recovered << " requests recovered with " << repairs << " repair packets ("
+                  << repairs * 1024 / 1000.0 << " kB, " << (g_txPackets ? 100.0 * repairs / g_txPackets : 0.0)
+                  << "% of the requests)" << std::endl;
+    }
+  if (g_config.traceMode == "record")
+    WriteLinkTrace(g_config.traceFile);
+
+  MobilityResult result;
+  result.outage = outage.first.GetSeconds();
+  result.lost = outage.second;
+  result.fecRepairs = repairs;
+  result.fecRecovered = recovered;
+
+  // Convergence after the first insertion and the first removal of relays
+  bool inserted = false;
+  bool removed = false;
+  for (size_t i = 0; i < g_topologyChanges.size(); i++)
+    {
+      const TopologyChange &change = g_topologyChanges[i];
+      Time until = i + 1 < g_topologyChanges.size() ? g_topologyChanges[i + 1].at : Seconds(60.0);
+      std::pair<double, uint64_t> converged = ConvergenceAfter(change.at, until);
+      if (!g_config.quiet)
+        std::cout << "Topology change at " << change.at.GetSeconds() << "s (" << change.what
+                  << "): first delivery on the new path after "
+                  << (converged.first >= 0 ? std::to_string(converged.first) + "s" : std::string("never")) << ", "
+                  << converged.second << " requests lost while converging" << std::endl;
+      if (change.what == "relays inserted" && !inserted)
+        {
+          inserted = true;
+          result.insertionConvergence = converged.first;
+          result.insertionLost = converged.second;
+        }
+      else if (change.what != "relays inserted" && !removed)
+        {
+          removed = true;
+          result.removalConvergence = converged.first;
+          result.removalLost = converged.second;
+        }
+    }
+
+  if (g_deployment.triggered)
+    result.triggerTime = g_deployment.triggerTime.GetSeconds();
+  if (g_deployment.recovered)
+    result.pathSetup = (g_deployment.recoveredTime - g_deployment.usableTime).GetSeconds();
+  if (!g_config.quiet && g_config.forwarding != "routed")
+    std::cout << g_pathDiscoveries.size() << " HWMP path discoveries, first "
+              << FirstPathDiscoveryAfterArrival() << "s after the drones powered on, mean after arrival "
+              << MeanPathDiscoveryAfterArrival() << "s" << std::endl;
+  if (!g_config.quiet && !g_reassocGaps.empty())
+    {
+      std::vector<double> gaps;
+      for (const Time &gap : g_reassocGaps)
+        gaps.push_back(gap.GetSeconds());
+      PrintLatencyDistribution("Reassociation", gaps);
+    }
+  result.meanDiscovery = MeanPathDiscoveryAfterArrival();
+  result.firstDiscovery = FirstPathDiscoveryAfterArrival();
+  result.meanReassociation = MeanReassociationTime();
+  return result;
+}
+
+// Run the mobility scenario without drones, with the reactive loss trigger
+// and with the predictive trigger (in parallel) and compare what they lose
+void RunTriggerComparison()
+{
+  const std::vector<std::string> triggers = {"", "loss", "predictive"};
+  std::vector<std::vector<double>> results = RunParallel(triggers.size(), [&](uint32_t job) {
+    g_config.trigger = triggers[job];
+    g_config.adhocBaseline = true;
+    g_config.quiet = true;
+    return RunMobility().ToValues();
+  });
+
+  std::vector<MobilityResult> runs;
+  for (const std::vector<double> &values : results)
+    runs.push_back(MobilityResult::FromValues(values));
+  for (size_t i = 0; i < triggers.size(); i++)
+    {
+      std::cout << (triggers[i] == "" ? "none" : triggers[i]) << ": outage " << runs[i].outage << "s, "
+                << runs[i].lost << " requests lost";
+      if (runs[i].triggerTime >= 0)
+        std::cout << ", deployed at " << runs[i].triggerTime << "s";
+      std::cout << std::endl;
+    }
+  const MobilityResult &loss = runs[1];
+  const MobilityResult &predictive = runs[2];
+  std::cout << "Predictive vs loss trigger: " << loss.outage - predictive.outage << "s less outage, "
+            << loss.lost - predictive.lost << " fewer requests lost ("
+            << (loss.lost - predictive.lost) * 1024 / 1000.0 << " kB)" << std::endl;
+}
+
+// Loss-triggered mobility runs without and with FEC: how much later the
+// trigger fires and what the repairs cost
+void RunFecComparison()
+{
+  std::vector<std::vector<double>> results = RunParallel(2, [](uint32_t job) {
+    g_config.fec = job == 1;
+    g_config.quiet = true;
+    if (g_config.trigger == "")
+      g_config.trigger = "loss";
+    return RunMobility().ToValues();
+  });
+
+  MobilityResult plain = MobilityResult::FromValues(results[0]);
+  MobilityResult fec = MobilityResult::FromValues(results[1]);
+  for (const MobilityResult *run : {&plain, &fec})
+    {
+      std::cout << (run == &fec ? "fec" : "plain") << ": outage " << run->outage << "s, " << run->lost
+                << " requests lost, ";
+      if (run->triggerTime >= 0)
+        std::cout << "deployed at " << run->triggerTime << "s";
+      else
+        std::cout << "never deployed";
+      if (run == &fec)
+        std::cout << ", " << run->fecRecovered << " requests recovered with " << run->fecRepairs << " repairs ("
+                  << run->fecRepairs * 1024 / 1000.0 << " kB)";
+      std::cout << std::endl;
+    }
+  if (plain.triggerTime >= 0 && fec.triggerTime >= 0)
+    std::cout << "FEC delays deployment by " << fec.triggerTime - plain.triggerTime << "s" << std::endl;
+  else if (plain.triggerTime >= 0)
+    std::cout << "FEC avoids deployment altogether" << std::endl;
+}
+
+// Convergence of routed relays per routing protocol: time to the first
+// delivery and requests lost after the drones join and after they leave
+void RunRoutingComparison()
+{
+  // "static+arp" is the best case: controller routes and pre-resolved neighbours
+  const std::vector<std::string> protocols = {"static", "static+arp", "olsr", "aodv", "dsdv"};
+  std::vector<std::vector<double>> results = RunParallel(protocols.size(), [&](uint32_t job) {
+    g_config.forwarding = "routed";
+    g_config.prepopulateArp = protocols[job] == "static+arp";
+    g_config.routing = g_config.prepopulateArp ? "static" : protocols[job];
+    g_config.quiet = true;
+    if (g_config.trigger == "")
+      g_config.trigger = "loss";
+    return RunMobility().ToValues();
+  });
+
+  auto printChange = [](const std::string &what, double converged, double lost) {
+    std::cout << what << " ";
+    if (converged >= 0)
+      std::cout << converged << "s";
+    else
+      std::cout << "never";
+    std::cout << " (" << lost << " lost)";
+  };
+  for (size_t i = 0; i < protocols.size(); i++)
+    {
+      MobilityResult run = MobilityResult::FromValues(results[i]);
+      std::cout << protocols[i] << ": outage " << run.outage << "s, " << run.lost << " requests lost; ";
+      printChange("converged after insertion", run.insertionConvergence, run.insertionLost);
+      if (g_config.recallTime.IsStrictlyPositive())
+        printChange(", after removal", run.removalConvergence, run.removalLost);
+      std::cout << std::endl;
+    }
+}
+
+// Goodput and queue sojourn times at the AP and relays for every queue disc,
+// under a saturating load through `relays` relays to a user at userDistance
+void RunQueueDiscComparison()
+{
+  const std::vector<std::string> queueDiscs = {"default", "pfifo", "codel", "fqcodel", "pie"};
+  Vector userPos(g_config.userDistance, 0.0, 0.0);
+  std::vector<std::vector<double>> results = RunParallel(queueDiscs.size(), [&](uint32_t job) {
+    g_config.queueDisc = queueDiscs[job];
+    std::vector<double> values(1, MeasureGoodput(userPos, EvenlySpacedRelays(userPos, g_config.relays)));
+    // Per node (AP, then relays, by node id): median, 99th percentile, max
+    for (const auto &node : g_nodeNames)
+      {
+        if (node.second == "user")
+          continue;
+        SojournHistogram sojourn = NodeTcSojourn(node.first);
+        for (double q : {0.5, 0.99, 1.0})
+          values.push_back(SojournPercentile(sojourn, q));
+      }
+    return values;
+  });
+
+  for (size_t i = 0; i < queueDiscs.size(); i++)
+    {
+      const std::vector<double> &r = results[i];
+      std::cout << queueDiscs[i] << ": " << r[0] << " Mbps";
+      for (size_t n = 0; 1 + 3 * n < r.size(); n++)
+        std::cout << (n == 0 ? "; sojourn " : ", ") << (n == 0 ? "ap" : "relay" + std::to_string(n - 1)) << " median "
+                  << 1000.0 * r[1 + 3 * n] << " ms p99 " << 1000.0 * r[2 + 3 * n] << " ms max "
+                  << 1000.0 * r[3 + 3 * n] << " ms";
+      std::cout << std::endl;
+    }
+}
+
+// Handover latency over handoverRuns bridged mobility runs with different
+// random streams (scanning and beacon timing), one handover per run
+void RunHandoverDistribution()
+{
+  std::vector<std::vector<double>> results = RunParallel(g_config.handoverRuns, [&](uint32_t run) {
+    RngSeedManager::SetRun(run + 1);
+    g_config.forwarding = "bridged";
+    g_config.quiet = true;
+    if (g_config.trigger == "")
+      g_config.trigger = "loss";
+    return RunMobility().ToValues();
+  });
+
+  std::vector<double> latencies;
+  std::vector<double> outages;
+  for (const std::vector<double> &values : results)
+    {
+      MobilityResult run = MobilityResult::FromValues(values);
+      if (run.meanReassociation >= 0)
+        latencies.push_back(run.meanReassociation);
+      outages.push_back(run.outage);
+    }
+  std::cout << g_config.handoverRuns << " runs, " << g_config.handover << " handover, beacon interval "
+            << g_config.beaconInterval.GetMilliSeconds() << " ms, "
+            << (g_config.activeProbing ? "active" : "passive") << " scanning" << std::endl;
+  PrintLatencyDistribution("Handover latency", latencies);
+  PrintLatencyDistribution("Outage", outages);
+}
+
+// Compare IP routing, 802.11s mesh and bridged forwarding: path setup after the
+// drones arrive and outage in the mobility run (loss trigger unless another
+// is set), and goodput of a probe with `relays` relays at userDistance
+void RunForwardingComparison()
+{
+  const std::vector<std::string> modes = {"routed", "mesh", "bridged"};
+  Vector userPos(g_config.userDistance, 0.0, 0.0);
+  std::vector<std::vector<double>> results = RunParallel(2 * modes.size(), [&](uint32_t job) {
+    g_config.forwarding = modes[job % modes.size()];
+    g_config.quiet = true;
+    if (job < modes.size())
+      {
+        if (g_config.trigger == "")
+          g_config.trigger = "loss";
+        return RunMobility().ToValues();
+      }
+    return std::vector<double>{MeasureGoodput(userPos, EvenlySpacedRelays(userPos, g_config.relays))};
+  });
+
+  for (size_t i = 0; i < modes.size(); i++)
+    {
+      MobilityResult run = MobilityResult::FromValues(results[i]);
+      std::cout << modes[i] << ": outage " << run.outage << "s, " << run.lost << " requests lost, path set up ";
+      if (run.pathSetup >= 0)
+        std::cout << run.pathSetup << "s after the drones arrived";
+      else
+        std::cout << "never";
+      if (run.firstDiscovery >= 0)
+        std::cout << " (first HWMP path " << 1000.0 * run.firstDiscovery << " ms after power-on, mean discovery "
+                  << 1000.0 * run.meanDiscovery << " ms)";
+      if (run.meanReassociation >= 0)
+        std::cout << ", mean reassociation " << 1000.0 * run.meanReassociation << " ms";
+      std::cout << "; " << results[modes.size() + i][0] << " Mbps with " << g_config.relays << " relay(s) at "
+                << g_config.userDistance << " m" << std::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+  Time::SetResolution(Time::NS);
+
+  CommandLine cmd(__FILE__);
+  cmd.AddValue("mode", "What to run: \"mobility\" (moving user), \"crossover\" (relay crossover search), \"heatmap\" (coverage map), \"placement\" (relay position search), \"chain\" (relay chain scaling), \"coding\" (two-way relay network coding), \"duplication\" (multipath duplication), \"exor\" (opportunistic forwarding) or \"cells\" (multi-cell power control)", g_config.mode);
+  cmd.AddValue("traceMode", "Channel trace mode: \"record\" or \"replay\" (empty disables)", g_config.traceMode);
+  cmd.AddValue("traceFile", "File the per-link error trace is written to / read from", g_config.traceFile);
+  cmd.AddValue("traceBin", "Time bin used when recording the per-link error trace", g_config.traceBin);
+  cmd.AddValue("replayRss", "Fixed receive power (dBm) of the simplified PHY used in replay", g_config.replayRss);
+  cmd.AddValue("standard", "Wi-Fi standard of every node: 80211n, 80211ac or 80211ax", g_config.standard);
+  cmd.AddValue("channelWidth", "Channel width (MHz) of every node", g_config.channelWidth);
+  cmd.AddValue("guardInterval", "Guard interval (ns) of every node: 400/800 (n, ac) or 800/1600/3200 (ax)", g_config.guardInterval);
+  cmd.AddValue("spatialStreams", "Antennas and spatial streams of every node", g_config.spatialStreams);
+  cmd.AddValue("userRadio", "User radio override as \"standard,width,gi,streams\"", g_config.userRadio);
+  cmd.AddValue("apRadio", "AP radio override as \"standard,width,gi,streams\"", g_config.apRadio);
+  cmd.AddValue("relayRadio", "Relay radio override as \"standard,width,gi,streams\"", g_config.relayRadio);
+  cmd.AddValue("maxAmpduSize", "Maximum A-MPDU size (bytes, 0 disables) of every node", g_config.maxAmpduSize);
+  cmd.AddValue("maxAmsduSize", "Maximum A-MSDU size (bytes, 0 disables) of every node", g_config.maxAmsduSize);
+  cmd.AddValue("blockAckThreshold", "Queued packets needed to set up a Block Ack agreement (0: never, but A-MPDU uses Block Ack regardless)", g_config.blockAckThreshold);
+  cmd.AddValue("blockAckTimeout", "Block Ack inactivity timeout in units of 1024 us (0: never)", g_config.blockAckTimeout);
+  cmd.AddValue("userAggregation", "User aggregation override as \"ampdu,amsdu\" bytes", g_config.userAggregation);
+  cmd.AddValue("apAggregation", "AP aggregation override as \"ampdu,amsdu\" bytes", g_config.apAggregation);
+  cmd.AddValue("relayAggregation", "Relay aggregation override as \"ampdu,amsdu\" bytes", g_config.relayAggregation);
+  cmd.AddValue("rateManager", "Rate adaptation: Constant, Ideal, MinstrelHt or ThompsonSampling", g_config.rateManager);
+  cmd.AddValue("constantMcs", "MCS index used by the Constant rate manager", g_config.constantMcs);
+  cmd.AddValue("mcsFile", "CSV file for the per-link MCS time series of the mobility run (empty disables)", g_config.mcsFile);
+  cmd.AddValue("queueDisc", "Queue disc on the AP's and relays' interfaces: default, pfifo, codel, fqcodel or pie", g_config.queueDisc);
+  cmd.AddValue("compareQueueDiscs", "Compare goodput and queue sojourn times through the relays for every queue disc", g_config.compareQueueDiscs);
+  cmd.AddValue("queueSampleInterval", "Sampling period of the MAC and traffic-control queue lengths", g_config.queueSampleInterval);
+  cmd.AddValue("codingHold", "Longest time the coding relay holds a packet waiting for one in the opposite direction", g_config.codingHold);
+  cmd.AddValue("duplicationRate", "Offered load of the duplication mode", g_config.duplicationRate);
+  cmd.AddValue("duplicationWindow", "Sequence numbers the duplication receiver remembers", g_config.duplicationWindow);
+  cmd.AddValue("exorRate", "Offered load of the opportunistic forwarding mode", g_config.exorRate);
+  cmd.AddValue("exorSlot", "Opportunistic forwarding: hold per higher-priority relay", g_config.exorSlot);
+  cmd.AddValue("powerControl", "Probes: set AP and relay TX power to the lowest meeting the target MCS on every hop", g_config.powerControl);
+  cmd.AddValue("powerTargetMcs", "MCS whose receiver sensitivity power control targets", g_config.powerTargetMcs);
+  cmd.AddValue("powerMargin", "Margin (dB) power control adds to the target sensitivity", g_config.powerMargin);
+  cmd.AddValue("cells", "Number of cells in the cells mode", g_config.cells);
+  cmd.AddValue("cellSpacing", "Distance (m) between neighbouring cells' APs", g_config.cellSpacing);
+  cmd.AddValue("fec", "Protect the echo requests with block FEC sized by the measured loss", g_config.fec);
+  cmd.AddValue("fecBlock", "Echo requests per FEC block", g_config.fecBlock);
+  cmd.AddValue("fecMinRepair", "FEC repair packets per block on a loss-free link", g_config.fecMinRepair);
+  cmd.AddValue("fecMaxRepair", "Most FEC repair packets per block", g_config.fecMaxRepair);
+  cmd.AddValue("compareFec", "Run the loss-triggered mobility scenario without and with FEC and compare", g_config.compareFec);
+  cmd.AddValue("relayRadios", "Radios per drone: 1 (shared channel) or 2 (separate access and backhaul channels)", g_config.relayRadios);
+  cmd.AddValue("forwarding", "How relays forward: \"routed\" (IP host routes), \"mesh\" (802.11s mesh points with HWMP) or \"bridged\" (repeater APs with the AP's SSID)", g_config.forwarding);
+  cmd.AddValue("compareForwarding", "Compare routed, mesh and bridged relays: path setup, reassociation, outage and goodput", g_config.compareForwarding);
+  cmd.AddValue("beaconInterval", "Beacon interval of the AP and drone APs", g_config.beaconInterval);
+  cmd.AddValue("activeProbing", "Let the user STA scan with probe requests instead of waiting for beacons", g_config.activeProbing);
+  cmd.AddValue("maxMissedBeacons", "Missed beacons after which the user STA leaves its BSS", g_config.maxMissedBeacons);
+  cmd.AddValue("handover", "Bridged handover: \"roam\" (user leaves the AP on beacon loss) or \"directed\" (controller moves it to the drone APs' channel)", g_config.handover);
+  cmd.AddValue("handoverRuns", "Bridged mobility runs (with different random streams) for a handover latency distribution", g_config.handoverRuns);
+  cmd.AddValue("routing", "Routing of routed relays: \"static\" (installed by the controller), \"olsr\", \"aodv\" or \"dsdv\"", g_config.routing);
+  cmd.AddValue("compareRouting", "Compare convergence after relays join and leave for every routing protocol", g_config.compareRouting);
+  cmd.AddValue("prepopulateArp", "With static routing, have the controller also fill the relay hops' ARP caches", g_config.prepopulateArp);
+  cmd.AddValue("recallTime", "Time at which deployed drones leave the chain (0: never)", g_config.recallTime);
+  cmd.AddValue("channelAssignment", "Backhaul channels of dual-radio chains: \"alternate\" or \"reuse\" (greedy spatial reuse under the propagation model)", g_config.channelAssignment);
+  cmd.AddValue("channelCount", "Backhaul channels available to the channel assignment (0: all of the relay width)", g_config.channelCount);
+  cmd.AddValue("propagation", "Path loss model: \"logdistance\" or \"a2g\" (air-to-ground)", g_config.propagation);
+  cmd.AddValue("a2gEnvironment", "Air-to-ground environment: suburban, urban, denseurban or highrise", g_config.a2gEnvironment);
+  cmd.AddValue("relays", "Number of relays between the user and the AP in snapshot probes", g_config.relays);
+  cmd.AddValue("probeTime", "Measured duration of a snapshot probe", g_config.probeTime);
+  cmd.AddValue("probeWarmup", "Unmeasured start of a snapshot probe", g_config.probeWarmup);
+  cmd.AddValue("probeRate", "Offered load of a snapshot probe", g_config.probeRate);
+  cmd.AddValue("jobs", "Number of probe processes run in parallel", g_config.jobs);
+  cmd.AddValue("crossoverMin", "Lower end (m) of the crossover search interval", g_config.crossoverMin);
+  cmd.AddValue("crossoverMax", "Upper end (m) of the crossover search interval", g_config.crossoverMax);
+  cmd.AddValue("crossoverTolerance", "Width (m) at which the crossover search stops", g_config.crossoverTolerance);
+  cmd.AddValue("gridRadius", "Half-width (m) of the square heatmap grid centred on the AP", g_config.gridRadius);
+  cmd.AddValue("gridStep", "Spacing (m) of heatmap cells", g_config.gridStep);
+  cmd.AddValue("placementSteps", "Candidate relay positions tried per heatmap cell", g_config.placementSteps);
+  cmd.AddValue("heatmapRelays", "Largest number of relays evaluated per heatmap cell (1 or 2)", g_config.heatmapRelays);
+  cmd.AddValue("placementAltitudes", "Comma-separated relay altitudes (m) tried by placement searches (default: droneAltitude)", g_config.placementAltitudes);
+  cmd.AddValue("userDistance", "User distance (m) from the AP in the placement search", g_config.userDistance);
+  cmd.AddValue("heatmapFile", "Base name of the heatmap .csv and .bin outputs", g_config.heatmapFile);
+  cmd.AddValue("trigger", "Drone deployment trigger in the mobility run: \"loss\" or \"predictive\" (empty disables)", g_config.trigger);
+  cmd.AddValue("drones", "Number of drones deployed as a relay chain", g_config.drones);
+  cmd.AddValue("lossThreshold", "Loss ratio over one monitor interval that triggers deployment", g_config.lossThreshold);
+  cmd.AddValue("fixableLossOnly", "Loss trigger: only deploy when link failures a relay can fix outnumber other drops", g_config.fixableLossOnly);
+  cmd.AddValue("droneSpeed", "Drone cruise speed (m/s)", g_config.droneSpeed);
+  cmd.AddValue("droneAccel", "Drone horizontal acceleration and deceleration (m/s^2)", g_config.droneAccel);
+  cmd.AddValue("climbRate", "Drone vertical speed (m/s)", g_config.climbRate);
+  cmd.AddValue("droneAltitude", "Altitude (m) at which drones hover at their relay point", g_config.droneAltitude);
+  cmd.AddValue("flightStep", "Sampling step of the flight waypoints", g_config.flightStep);
+  cmd.AddValue("degradeRss", "Predicted RSS (dBm) from the AP below which the direct link counts as degraded", g_config.degradeRss);
+  cmd.AddValue("predictStep", "Time step of the predictive trigger's trajectory extrapolation", g_config.predictStep);
+  cmd.AddValue("predictHorizon", "How far ahead the predictive trigger extrapolates", g_config.predictHorizon);
+  cmd.AddValue("predictMargin", "How early the predictive trigger wants the drones on station", g_config.predictMargin);
+  cmd.AddValue("adhocBaseline", "Run the mobility scenario without drones on the ad-hoc network instead of a BSS", g_config.adhocBaseline);
+  cmd.AddValue("compareTriggers", "Run the mobility scenario with no, reactive and predictive triggers and compare", g_config.compareTriggers);
+  cmd.Parse(argc, argv);
+
+  const std::string &traceMode = g_config.traceMode;
+  if (traceMode != "" && traceMode != "record" && traceMode != "replay")
+    NS_FATAL_ERROR("Unknown traceMode \"" << traceMode << "\"");
+  if (traceMode == "replay" && !ReadLinkTrace(g_config.traceFile, g_perTable))
+    NS_FATAL_ERROR("Cannot read link trace " << g_config.traceFile);
+  g_config.jobs = std::max(1u, g_config.jobs);
+  if (g_config.trigger != "" && g_config.trigger != "loss" && g_config.trigger != "predictive")
+    NS_FATAL_ERROR("Unknown trigger \"" << g_config.trigger << "\"");
+  if (g_config.forwarding != "routed" && g_config.forwarding != "mesh" && g_config.forwarding != "bridged")
+    NS_FATAL_ERROR("Unknown forwarding \"" << g_config.forwarding << "\"");
+  if (g_config.queueDisc != "default" && g_config.queueDisc != "pfifo" && g_config.queueDisc != "codel" &&
+      g_config.queueDisc != "fqcodel" && g_config.queueDisc != "pie")
+    NS_FATAL_ERROR("Unknown queueDisc \"" << g_config.queueDisc << "\"");
+  NS_ABORT_MSG_IF(g_config.queueDisc != "default" &&
+                    (g_config.forwarding != "routed" || g_config.compareForwarding || g_config.handoverRuns > 0),
+                  "queueDisc needs routed forwarding");
+  if (g_config.routing != "static" && g_config.routing != "olsr" && g_config.routing != "aodv" &&
+      g_config.routing != "dsdv")
+    NS_FATAL_ERROR("Unknown routing \"" << g_config.routing << "\"");
+  if (g_config.handover != "roam" && g_config.handover != "directed")
+    NS_FATAL_ERROR("Unknown handover \"" << g_config.handover << "\"");
+  if (g_config.channelAssignment != "alternate" && g_config.channelAssignment != "reuse")
+    NS_FATAL_ERROR("Unknown channelAssignment \"" << g_config.channelAssignment << "\"");
+  NS_ABORT_MSG_IF(g_config.crossoverMin < 0 || g_config.crossoverMin >= g_config.crossoverMax,
+                  "crossoverMin must be non-negative and below crossoverMax");
+  NS_ABORT_MSG_IF(g_config.crossoverTolerance <= 0, "crossoverTolerance must be positive");
+  NS_ABORT_MSG_IF(g_config.droneSpeed <= 0 || g_config.droneAccel <= 0 || g_config.climbRate <= 0,
+                  "Drone speed, acceleration and climb rate must be positive");
+
+  if (g_config.handoverRuns > 0)
+    RunHandoverDistribution();
+  else if (g_config.compareRouting)
+    RunRoutingComparison();
+  else if (g_config.compareFec)
+    RunFecComparison();
+  else if (g_config.compareQueueDiscs)
+    RunQueueDiscComparison();
+  else if (g_config.compareForwarding)
+    RunForwardingComparison();
+  else if (g_config.mode == "mobility" && g_config.compareTriggers)
+    RunTriggerComparison();
+  else if (g_config.mode == "mobility")
+    RunMobility();
+  else if (g_config.mode == "crossover")
+    RunCrossover();
+  else if (g_config.mode == "heatmap")
+    RunHeatmap();
+  else if (g_config.mode == "placement")
+    RunPlacement();
+  else if (g_config.mode == "chain")
+    RunChain();
+  else if (g_config.mode == "coding")
+    RunCoding();
+  else if (g_config.mode == "duplication")
+    RunDuplication();
+  else if (g_config.mode == "exor")
+    RunExor();
+  else if (g_config.mode == "cells")
+    RunCells();
+  else
+    NS_FATAL_ERROR("Unknown mode \"" << g_config.mode << "\"");
   return 0;
 }